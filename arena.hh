@@ -0,0 +1,203 @@
+#pragma once
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Bump allocator for the short lived allocations of a single scribe job.
+///
+///		Allocations are carved from large blocks and never freed one by one, Reset releases
+///		everything at once. Reset keeps a single block sized to what the job used, so the next
+///		job of a batch on the same thread usually runs out of one block without touching the
+///		heap. Only the latest allocation can be handed back, which covers a vector growing at
+///		the top of the arena. Buffers left behind by other growing containers stay until Reset.
+///
+///		TCArenaAllocator adapts it for the standard containers. An allocator without an arena
+///		falls back to the heap, so arena backed containers also work outside of a job.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCArena
+{
+public:
+	static constexpr size_t MinBlockSize = 0x10000;
+
+	/* Reset frees the blocks instead of keeping one if they add up to more than this. */
+	static constexpr size_t MaxRetainedSize = 0x4000000;
+
+	struct Block
+	{
+		Block* mNext;
+		size_t mSize;
+	};
+
+	Block* mBlocks = 0;
+	u8* mBegin = 0;
+	u8* mCursor = 0;
+	u8* mEnd = 0;
+
+	size_t mBytesUsed = 0;
+	size_t mBytesReserved = 0;
+	u32 mNumBlocks = 0;
+
+	TCArena() = default;
+	TCArena(const TCArena&) = delete;
+	TCArena& operator=(const TCArena&) = delete;
+
+	~TCArena() { Release(); }
+
+	/* Arena of the calling thread, batch jobs running on the same pool thread share its blocks. */
+	static TCArena& GetThreadArena()
+	{
+		static thread_local TCArena arena;
+		return arena;
+	}
+
+	static u8* AlignUp(u8* ptr, size_t align) { return reinterpret_cast<u8*>((reinterpret_cast<uptr>(ptr) + (align - 1)) & ~static_cast<uptr>(align - 1)); }
+
+	void* Allocate(size_t size, size_t align)
+	{
+		u8* ptr = AlignUp(mCursor, align);
+		if (!mCursor || ptr > mEnd || size > static_cast<size_t>(mEnd - ptr))
+		{
+			AddBlock(size + align);
+			ptr = AlignUp(mCursor, align);
+		}
+
+		mCursor = ptr + size;
+		mBytesUsed += size;
+		return ptr;
+	}
+
+	void Free(void* ptr, size_t size)
+	{
+		auto bytes = static_cast<u8*>(ptr);
+		if (bytes >= mBegin && bytes + size == mCursor)
+		{
+			mCursor = bytes;
+			mBytesUsed -= size;
+		}
+	}
+
+	void AddBlock(size_t minSize)
+	{
+		size_t size = (mBytesReserved > MinBlockSize ? mBytesReserved : MinBlockSize);
+		if (minSize + sizeof(Block) > size) {
+			size = minSize + sizeof(Block);
+		}
+
+		auto block = static_cast<Block*>(malloc(size));
+		if (!block) {
+			throw std::bad_alloc();
+		}
+
+		block->mNext = mBlocks;
+		block->mSize = size;
+		mBlocks = block;
+
+		mBegin = mCursor = reinterpret_cast<u8*>(block + 1);
+		mEnd = reinterpret_cast<u8*>(block) + size;
+
+		mBytesReserved += size;
+		++mNumBlocks;
+	}
+
+	void Release()
+	{
+		while (mBlocks)
+		{
+			auto next = mBlocks->mNext;
+			free(mBlocks);
+			mBlocks = next;
+		}
+
+		mBegin = mCursor = mEnd = 0;
+		mBytesUsed = mBytesReserved = 0;
+		mNumBlocks = 0;
+	}
+
+	/* Releases every allocation, all containers using the arena must be gone by now. */
+	void Reset()
+	{
+		const size_t reserved = mBytesReserved;
+		if (mNumBlocks > 1 || reserved > MaxRetainedSize)
+		{
+			Release();
+
+			if (MaxRetainedSize >= reserved) {
+				AddBlock(reserved - sizeof(Block));
+			}
+		}
+
+		mCursor = mBegin;
+		mBytesUsed = 0;
+	}
+};
+
+/* Resets the arena when the job ends, declare it before anything that allocates from the arena. */
+class TCArenaScope
+{
+public:
+	TCArena* mArena;
+
+	TCArenaScope(TCArena* arena) : mArena(arena) {}
+	TCArenaScope(const TCArenaScope&) = delete;
+	TCArenaScope& operator=(const TCArenaScope&) = delete;
+
+	~TCArenaScope()
+	{
+		if (mArena) {
+			mArena->Reset();
+		}
+	}
+};
+
+template <typename T>
+class TCArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	TCArena* mArena;
+
+	TCArenaAllocator(TCArena* arena = 0) noexcept : mArena(arena) {}
+
+	template <typename U>
+	TCArenaAllocator(const TCArenaAllocator<U>& other) noexcept : mArena(other.mArena) {}
+
+	T* allocate(size_t n)
+	{
+		if (mArena) {
+			return static_cast<T*>(mArena->Allocate(n * sizeof(T), alignof(T)));
+		}
+
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* ptr, size_t n) noexcept
+	{
+		if (mArena) {
+			mArena->Free(ptr, n * sizeof(T));
+		}
+		else {
+			::operator delete(ptr);
+		}
+	}
+
+	template <typename U>
+	bool operator==(const TCArenaAllocator<U>& other) const noexcept { return mArena == other.mArena; }
+
+	template <typename U>
+	bool operator!=(const TCArenaAllocator<U>& other) const noexcept { return mArena != other.mArena; }
+};
+
+template <typename T>
+using TCArenaVector = std::vector<T, TCArenaAllocator<T>>;
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+using TCArenaHashMap = std::unordered_map<K, V, Hash, std::equal_to<K>, TCArenaAllocator<std::pair<const K, V>>>;
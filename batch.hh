@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "jobs.hh"
+#include "threadpool.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Batch mode, runs conversion or scribe jobs for many files on a thread pool.
+///
+///		The input can be:
+///		- a directory: every file with the input extension (.bin for -conv, .xml for -scribe),
+///		- a glob: a path whose file name part contains '*' or '?',
+///		- a list file: one path per line, empty lines and lines starting with '#' are skipped.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCBatch
+{
+public:
+	std::vector<std::string> mFiles;
+
+	static bool WildcardMatch(const char* pattern, const char* str)
+	{
+		const char* star = 0;
+		const char* backtrack = 0;
+
+		while (*str)
+		{
+			if (*pattern == '?' || *pattern == *str)
+			{
+				++pattern;
+				++str;
+			}
+			else if (*pattern == '*')
+			{
+				star = pattern++;
+				backtrack = str;
+			}
+			else if (star)
+			{
+				pattern = star + 1;
+				str = ++backtrack;
+			}
+			else {
+				return 0;
+			}
+		}
+
+		while (*pattern == '*') {
+			++pattern;
+		}
+
+		return !*pattern;
+	}
+
+	static bool HasExtension(const std::filesystem::path& path, const char* extension)
+	{
+		return !qStringCompareInsensitive(path.extension().string().c_str(), extension);
+	}
+
+	bool Collect(const char* input, const char* extension)
+	{
+		namespace fs = std::filesystem;
+
+		std::error_code ec;
+		fs::path inputPath = input;
+
+		if (fs::is_directory(inputPath, ec))
+		{
+			for (auto& entry : fs::directory_iterator(inputPath, ec))
+			{
+				if (entry.is_regular_file(ec) && HasExtension(entry.path(), extension)) {
+					mFiles.push_back(entry.path().string());
+				}
+			}
+
+			std::sort(mFiles.begin(), mFiles.end());
+		}
+		else if (inputPath.filename().string().find_first_of("*?") != std::string::npos)
+		{
+			const std::string pattern = inputPath.filename().string();
+
+			fs::path directory = inputPath.parent_path();
+			if (directory.empty()) {
+				directory = ".";
+			}
+
+			for (auto& entry : fs::directory_iterator(directory, ec))
+			{
+				if (entry.is_regular_file(ec) && WildcardMatch(pattern.c_str(), entry.path().filename().string().c_str())) {
+					mFiles.push_back(entry.path().string());
+				}
+			}
+
+			std::sort(mFiles.begin(), mFiles.end());
+		}
+		else
+		{
+			std::ifstream list(input);
+			if (!list)
+			{
+				qPrintf("ERROR: Failed to open batch input %s.\n", input);
+				return 0;
+			}
+
+			for (std::string line; std::getline(list, line);)
+			{
+				while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+					line.pop_back();
+				}
+
+				if (!line.empty() && line[0] != '#') {
+					mFiles.push_back(line);
+				}
+			}
+		}
+
+		if (mFiles.empty())
+		{
+			qPrintf("ERROR: No files to process in %s.\n", input);
+			return 0;
+		}
+
+		return 1;
+	}
+
+	/* Returns the number of files that failed. */
+	u32 Run(TCJobFunction job, TCJobOptions options, u32 numJobs)
+	{
+		ThreadPool pool(numJobs);
+		ThreadPool::TaskGroup group;
+
+		options.mPool = &pool;
+		options.mSharedPool = 1;
+
+		std::vector<u8> results(mFiles.size(), 0);
+
+		qPrintf("Processing %u file(s) on %u thread(s).\n", static_cast<u32>(mFiles.size()), pool.GetNumThreads());
+
+		for (size_t i = 0; mFiles.size() > i; ++i)
+		{
+			pool.Submit(group, [this, &results, &options, job, i]
+			{
+				auto start = std::chrono::steady_clock::now();
+
+				const qString filename = mFiles[i].c_str();
+				results[i] = job(filename, options);
+
+				const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				qPrintf("[%s] %s (%.1f ms)\n", (results[i] ? " OK " : "FAIL"), mFiles[i].c_str(), ms);
+			});
+		}
+
+		pool.Wait(group);
+
+		u32 numFailed = 0;
+		for (auto result : results) {
+			numFailed += !result;
+		}
+
+		qPrintf("Batch finished: %u succeeded, %u failed.\n", static_cast<u32>(mFiles.size()) - numFailed, numFailed);
+		return numFailed;
+	}
+};
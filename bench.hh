@@ -0,0 +1,161 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "generator.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Benchmark suite for conversion and scribing.
+///
+///		For every scale (number of resources per component) a database is generated, scribed
+///		with SimpleXML's XMLDocument and with the stage parser of -stream and converted back,
+///		serially and on the pool when one is given. Both conversions write through the same
+///		SimpleXML::XMLWriter, the pool only records the components, so the difference between
+///		the two rows is threading alone. Throughput is measured against the XML size and node
+///		count of each phase. Peak memory usage is the process peak, so it only grows over the run.
+///
+///		Symbols are not loaded, converted names go through the unresolved symbol path.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCBenchmark
+{
+public:
+	struct Result
+	{
+		u32 mScale;
+		const char* mPhase;
+		double mMilliseconds;
+		u64 mBytes;
+		u64 mNodes;
+		u64 mPeakMemoryUsage;
+	};
+
+	std::vector<Result> mResults;
+	ThreadPool* mPool = 0;
+
+	typedef std::chrono::steady_clock Clock;
+
+	void AddResult(u32 scale, const char* phase, Clock::time_point start, const std::string& filename, u64 nodes)
+	{
+		const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::error_code ec;
+		const u64 bytes = static_cast<u64>(std::filesystem::file_size(filename, ec));
+
+		mResults.push_back({ scale, phase, ms, (ec ? 0 : bytes), nodes, GetPeakMemoryUsage() });
+	}
+
+	bool Scribe(u32 scale, const char* phase, ETCXMLParser parser, const std::string& xmlFilename, const std::string& binFilename, u64 nodes)
+	{
+		auto start = Clock::now();
+
+		TCArenaScope arenaScope = { &TCArena::GetThreadArena() };
+
+		TCDatabaseScriber scriber = { xmlFilename.c_str(), parser, arenaScope.mArena };
+		if (!scriber.IsLoaded() || !scriber.Build()) {
+			return 0;
+		}
+
+		scriber.Export(binFilename.c_str());
+
+		AddResult(scale, phase, start, xmlFilename, nodes);
+		return 1;
+	}
+
+	bool Convert(u32 scale, const char* phase, ThreadPool* pool, const std::string& binFilename, const std::string& xmlFilename)
+	{
+		auto start = Clock::now();
+
+		TCDatabaseLoader loader;
+		if (!loader.Load(binFilename.c_str())) {
+			return 0;
+		}
+
+		u64 nodes = 0;
+		{
+			TCDatabaseConverter converter = { loader.mDB, loader.mVersion, xmlFilename.c_str(), 0x8000, 0, 0, pool };
+			if (!converter.Export()) {
+				return 0;
+			}
+
+			nodes = converter.mXMLW->mNumNodes;
+		}
+
+		AddResult(scale, phase, start, xmlFilename, nodes);
+		return 1;
+	}
+
+	bool RunScale(TCGeneratorOptions options, u32 scale, const std::string& directory)
+	{
+		options.mNumResources = scale;
+
+		const std::string base = directory + "/tcdb_bench_" + std::to_string(scale);
+		const std::string xmlFilename = base + ".xml";
+		const std::string binFilename = base + ".bin";
+		const std::string convFilename = base + "_conv.xml";
+
+		auto start = Clock::now();
+
+		TCDatabaseGenerator generator = { options };
+		if (!generator.Generate(xmlFilename.c_str())) {
+			return 0;
+		}
+
+		const u64 nodes = generator.mXMLW.mNumNodes;
+		AddResult(scale, "generate", start, xmlFilename, nodes);
+
+		bool result = Scribe(scale, "scribe", TCXML_PARSER_DOCUMENT, xmlFilename, binFilename, nodes) && Scribe(scale, "scribe -stream", TCXML_PARSER_STREAM, xmlFilename, binFilename, nodes)
+			&& Convert(scale, "conv", 0, binFilename, convFilename) && (!mPool || Convert(scale, "conv -parallel", mPool, binFilename, convFilename));
+
+		std::error_code ec;
+		std::filesystem::remove(xmlFilename, ec);
+		std::filesystem::remove(binFilename, ec);
+		std::filesystem::remove(base + "_qsymbols.txt", ec);
+		std::filesystem::remove(convFilename, ec);
+
+		return result;
+	}
+
+	/* scales is a comma separated list of resources per component, e.g. "10,100,1000". */
+	bool Run(const char* scales, const TCGeneratorOptions& options, const char* directory)
+	{
+		const std::string outputDirectory = (directory && *directory ? directory : ".");
+
+		for (const char* scale = scales; *scale;)
+		{
+			char* end;
+			const u32 numResources = static_cast<u32>(strtoul(scale, &end, 10));
+			if (end == scale || !numResources)
+			{
+				qPrintf("ERROR: Invalid benchmark scale %s.\n", scale);
+				return 0;
+			}
+
+			if (!RunScale(options, numResources, outputDirectory))
+			{
+				qPrintf("ERROR: Benchmark failed at scale %u.\n", numResources);
+				return 0;
+			}
+
+			scale = (*end == ',' ? end + 1 : end);
+		}
+
+		qPrintf("\n%-8s %-16s %12s %10s %10s %12s %12s\n", "Scale", "Phase", "Time (ms)", "MiB", "MiB/s", "Mnodes/s", "Peak (MiB)");
+
+		for (auto& result : mResults)
+		{
+			const double seconds = result.mMilliseconds / 1000.0;
+			const double mib = BytesToMiB(result.mBytes);
+
+			qPrintf("%-8u %-16s %12.1f %10.2f %10.1f %12.2f %12.1f\n", result.mScale, result.mPhase, result.mMilliseconds, mib,
+				(seconds > 0.0 ? mib / seconds : 0.0), (seconds > 0.0 ? static_cast<double>(result.mNodes) / seconds / 1000000.0 : 0.0), BytesToMiB(result.mPeakMemoryUsage));
+		}
+
+		return 1;
+	}
+};
@@ -0,0 +1,393 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "platform.hh"
+#include "stage.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Sidecar cache for incremental scribing (.tccache next to the .bin).
+///
+///		For every <Component> the cache keeps a FNV-1a hash of its staged subtree and the bytes
+///		it produced in each schema array (resource entries, LODs, model parts, texture set
+///		array, texture sets, colour tints, override params and the string buffer). Components
+///		are built in document order, so each of them owns one contiguous slice per array.
+///
+///		A component with an unchanged hash is copied back from the cache and its qOffset64
+///		values are relinked: they are self-relative, so a pointer stored in slice S that
+///		targets slice T becomes old + (delta T - delta S). HighResolutionResource references
+///		are stored by name and resolved again like in a full build, as are the symbols the
+///		component created.
+///
+///		The cache key covers the tag list, the output layout and the struct sizes, if any of
+///		them changed every component is rebuilt.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCDatabaseCache
+{
+public:
+	static constexpr u32 Magic = 0x43444354; // "TCDC"
+	static constexpr u32 Version = 1;
+
+	enum ESlice
+	{
+		SLICE_RESOURCE_ENTRIES,
+		SLICE_LODS,
+		SLICE_MODEL_PARTS,
+		SLICE_TEXTURE_SET_ARRAY,
+		SLICE_TEXTURE_SETS,
+		SLICE_COLOUR_TINTS,
+		SLICE_TEXTURE_OVERRIDE_PARAMS,
+		SLICE_STRINGS,
+		NUM_SLICES
+	};
+
+	struct Symbol
+	{
+		u32 mUID;
+		const char* mStr;
+	};
+
+	struct Fixup
+	{
+		/* Byte offset of the qOffset64 from the start of the resource entry or texture set slice. */
+		u32 mOffset;
+		u32 mIsTextureSet;
+		const char* mName;
+	};
+
+	struct Component
+	{
+		u64 mHash = 0;
+
+		/* Byte offset of every slice from the start of the database, used for relinking. */
+		u64 mSliceOffset[NUM_SLICES] = {};
+		u32 mSliceSize[NUM_SLICES] = {};
+		const u8* mSliceData[NUM_SLICES] = {};
+
+		u32 mNumUnknownTags = 0;
+
+		std::vector<Symbol> mSymbols;
+		std::vector<Fixup> mFixups;
+	};
+
+	FileMapping mMapping;
+	u64 mKey = 0;
+
+	std::vector<Component> mComponents;
+	std::unordered_map<u64, const Component*> mComponentIndex;
+
+	//------------------------------------
+	//	Hash
+	//------------------------------------
+
+	struct Hash
+	{
+		u64 mValue = 0xCBF29CE484222325ull;
+
+		void Add(const void* data, size_t size)
+		{
+			auto bytes = static_cast<const u8*>(data);
+			for (size_t i = 0; size > i; ++i)
+			{
+				mValue ^= bytes[i];
+				mValue *= 0x100000001B3ull;
+			}
+		}
+
+		void Add(u32 value) { Add(&value, sizeof(value)); }
+
+		void Add(const char* str) { Add(str, qStringLength(str) + 1); }
+	};
+
+	static u64 HashKey(const TCDatabaseStage& stage, u32 layoutVersion)
+	{
+		Hash hash;
+		hash.Add(Version);
+		hash.Add(layoutVersion);
+		hash.Add(static_cast<u32>(sizeof(TrueCrowdDataBase::ResourceEntry)));
+		hash.Add(static_cast<u32>(sizeof(TrueCrowdLOD)));
+		hash.Add(static_cast<u32>(sizeof(TrueCrowdModelPart)));
+		hash.Add(static_cast<u32>(sizeof(qOffset64<TrueCrowdTextureSet*>)));
+		hash.Add(static_cast<u32>(sizeof(TrueCrowdTextureSet)));
+		hash.Add(static_cast<u32>(sizeof(qColour)));
+		hash.Add(static_cast<u32>(sizeof(TextureOverrideParams)));
+
+		hash.Add(static_cast<u32>(stage.mTags.size()));
+		for (auto tag : stage.mTags) {
+			hash.Add(stage.GetString(tag));
+		}
+
+		return hash.mValue;
+	}
+
+	static void HashOptionalString(Hash& hash, const TCDatabaseStage& stage, u32 str)
+	{
+		hash.Add(static_cast<u32>(str != TCDatabaseStage::InvalidString));
+
+		if (str != TCDatabaseStage::InvalidString) {
+			hash.Add(stage.GetString(str));
+		}
+	}
+
+	/* Covers everything BuildComponent reads from the stage. */
+	static u64 HashComponent(const TCDatabaseStage& stage, const TCDatabaseStage::Component& component)
+	{
+		Hash hash;
+		hash.Add(stage.GetString(component.mName));
+		hash.Add(component.mResources.mCount);
+
+		for (u32 i = 0; component.mResources.mCount > i; ++i)
+		{
+			auto& resource = stage.mResources[component.mResources.mFirst + i];
+
+			hash.Add(stage.GetString(resource.mName));
+			hash.Add(static_cast<u32>(resource.mType));
+			HashOptionalString(hash, stage, resource.mHighResolutionResource);
+
+			hash.Add(resource.mTags.mCount);
+			for (u32 j = 0; resource.mTags.mCount > j; ++j) {
+				hash.Add(stage.GetString(stage.mResourceTags[resource.mTags.mFirst + j]));
+			}
+
+			hash.Add(resource.mLODs.mCount);
+			for (u32 j = 0; resource.mLODs.mCount > j; ++j)
+			{
+				auto& lod = stage.mLODs[resource.mLODs.mFirst + j];
+
+				hash.Add(lod.mModelParts.mCount);
+				for (u32 k = 0; lod.mModelParts.mCount > k; ++k)
+				{
+					auto& modelPart = stage.mModelParts[lod.mModelParts.mFirst + k];
+					hash.Add(stage.GetString(modelPart.mName));
+					hash.Add(static_cast<u32>(modelPart.mIsSkinned));
+					hash.Add(static_cast<u32>(modelPart.mMorphType));
+				}
+			}
+
+			hash.Add(resource.mTextureSets.mCount);
+			for (u32 j = 0; resource.mTextureSets.mCount > j; ++j)
+			{
+				auto& textureSet = stage.mTextureSets[resource.mTextureSets.mFirst + j];
+
+				hash.Add(stage.GetString(textureSet.mName));
+				HashOptionalString(hash, stage, textureSet.mHighResolutionResource);
+
+				hash.Add(textureSet.mColourTints.mCount);
+				for (u32 k = 0; textureSet.mColourTints.mCount > k; ++k) {
+					hash.Add(&stage.mColourTints[textureSet.mColourTints.mFirst + k], sizeof(TCDatabaseStage::ColourTint));
+				}
+
+				hash.Add(textureSet.mOverrideParams.mCount);
+				for (u32 k = 0; textureSet.mOverrideParams.mCount > k; ++k)
+				{
+					auto& param = stage.mOverrideParams[textureSet.mOverrideParams.mFirst + k];
+					hash.Add(stage.GetString(param.mSampler));
+					hash.Add(param.mNameUID);
+					hash.Add(param.mUID, sizeof(param.mUID));
+				}
+			}
+		}
+
+		return hash.mValue;
+	}
+
+	//------------------------------------
+	//	Load
+	//------------------------------------
+
+	struct Reader
+	{
+		const u8* mPtr;
+		const u8* mEnd;
+
+		const u8* Skip(size_t size)
+		{
+			if (size > static_cast<size_t>(mEnd - mPtr)) {
+				return 0;
+			}
+
+			const u8* data = mPtr;
+			mPtr += size;
+			return data;
+		}
+
+		template <typename T>
+		bool Read(T& value)
+		{
+			auto data = Skip(sizeof(T));
+			if (!data) {
+				return 0;
+			}
+
+			qMemCopy(&value, data, sizeof(T));
+			return 1;
+		}
+
+		const char* ReadString()
+		{
+			u32 len;
+			if (!Read(len)) {
+				return 0;
+			}
+
+			auto str = reinterpret_cast<const char*>(Skip(len + 1));
+			return (str && !str[len] ? str : 0);
+		}
+	};
+
+	/* A missing or unreadable cache leaves it empty, every component is then rebuilt. */
+	bool Load(const char* filename)
+	{
+		if (!mMapping.Open(filename)) {
+			return 0;
+		}
+
+		Reader reader = { static_cast<const u8*>(mMapping.mData), static_cast<const u8*>(mMapping.mData) + mMapping.mSize };
+
+		u32 magic, version, numComponents;
+		if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(mKey) || !reader.Read(numComponents) || magic != Magic || version != Version) {
+			return Reset(filename);
+		}
+
+		mComponents.resize(numComponents);
+
+		for (auto& component : mComponents)
+		{
+			u32 numSymbols, numFixups;
+			if (!reader.Read(component.mHash) || !reader.Read(component.mSliceOffset) || !reader.Read(component.mSliceSize) || !reader.Read(component.mNumUnknownTags)
+				|| !reader.Read(numSymbols) || !reader.Read(numFixups))
+			{
+				return Reset(filename);
+			}
+
+			for (u32 i = 0; NUM_SLICES > i; ++i)
+			{
+				component.mSliceData[i] = reader.Skip(component.mSliceSize[i]);
+				if (!component.mSliceData[i]) {
+					return Reset(filename);
+				}
+			}
+
+			component.mSymbols.resize(numSymbols);
+			for (auto& symbol : component.mSymbols)
+			{
+				if (!reader.Read(symbol.mUID) || !(symbol.mStr = reader.ReadString())) {
+					return Reset(filename);
+				}
+			}
+
+			component.mFixups.resize(numFixups);
+			for (auto& fixup : component.mFixups)
+			{
+				if (!reader.Read(fixup.mOffset) || !reader.Read(fixup.mIsTextureSet) || !(fixup.mName = reader.ReadString())) {
+					return Reset(filename);
+				}
+			}
+
+			mComponentIndex.emplace(component.mHash, &component);
+		}
+
+		return 1;
+	}
+
+	bool Reset(const char* filename)
+	{
+		qPrintf("WARN: Incremental cache %s is invalid and will be rebuilt.\n", filename);
+
+		Clear();
+		return 0;
+	}
+
+	void Clear()
+	{
+		mComponentIndex.clear();
+		mComponents.clear();
+		mMapping.Close();
+		mKey = 0;
+	}
+
+	const Component* Find(u64 hash) const
+	{
+		auto it = mComponentIndex.find(hash);
+		if (it == mComponentIndex.end()) {
+			return 0;
+		}
+
+		return it->second;
+	}
+
+	//------------------------------------
+	//	Save
+	//------------------------------------
+
+	static void Write(std::vector<u8>& buffer, const void* data, size_t size)
+	{
+		auto bytes = static_cast<const u8*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	static void Write(std::vector<u8>& buffer, const T& value) { Write(buffer, &value, sizeof(T)); }
+
+	static void WriteString(std::vector<u8>& buffer, const char* str)
+	{
+		const u32 len = static_cast<u32>(qStringLength(str));
+		Write(buffer, len);
+		Write(buffer, str, len + 1);
+	}
+
+	/* Serialized before anything is written, the components may still reference the mapping of the previous cache. */
+	bool Save(const char* filename, u64 key, const std::vector<Component>& components)
+	{
+		std::vector<u8> buffer;
+
+		Write(buffer, Magic);
+		Write(buffer, Version);
+		Write(buffer, key);
+		Write(buffer, static_cast<u32>(components.size()));
+
+		for (auto& component : components)
+		{
+			Write(buffer, component.mHash);
+			Write(buffer, component.mSliceOffset);
+			Write(buffer, component.mSliceSize);
+			Write(buffer, component.mNumUnknownTags);
+			Write(buffer, static_cast<u32>(component.mSymbols.size()));
+			Write(buffer, static_cast<u32>(component.mFixups.size()));
+
+			for (u32 i = 0; NUM_SLICES > i; ++i) {
+				Write(buffer, component.mSliceData[i], component.mSliceSize[i]);
+			}
+
+			for (auto& symbol : component.mSymbols)
+			{
+				Write(buffer, symbol.mUID);
+				WriteString(buffer, symbol.mStr);
+			}
+
+			for (auto& fixup : component.mFixups)
+			{
+				Write(buffer, fixup.mOffset);
+				Write(buffer, fixup.mIsTextureSet);
+				WriteString(buffer, fixup.mName);
+			}
+		}
+
+		Clear();
+
+		auto f = qOpen(filename, QACCESS_WRITE);
+		if (!f)
+		{
+			qPrintf("WARN: Failed to write incremental cache %s.\n", filename);
+			return 0;
+		}
+
+		qWriteString(f, reinterpret_cast<const char*>(buffer.data()), static_cast<s64>(buffer.size()));
+		qClose(f);
+		return 1;
+	}
+};
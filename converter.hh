@@ -1,36 +1,84 @@
 #pragma once
+#include <deque>
+#include <memory>
 #include <set>
+#include <unordered_map>
+#include "layout.hh"
+#include "xmlwriter.hh"
+#include "stats.hh"
+#include "symbols.hh"
+#include "threadpool.hh"
 
 using namespace UFG;
 
 class TCDatabaseConverter
 {
 public:
-	enum EVersion
-	{
-		VERSION_SDHD,
-		VERSION_TW
-	};
-
 	TrueCrowdDataBase* mDB;
-	EVersion mVersion;
-	SimpleXML::XMLWriter* mXMLW;
+	ETCDatabaseVersion mVersion;
+
+	/* Tag list, read once for the tag bit flags of every resource. */
+	qSymbol* mTags = 0;
+	u32 mNumTags = 0;
+	XMLBufferWriter* mXMLW;
+	bool mOwnsWriter;
+
+	/* Whether the output file could be opened, Export fails without it. */
+	bool mIsOpen = 1;
 
 	std::set<u32> mUnresolvedSymbols;
 
-	TCDatabaseConverter(TrueCrowdDataBase* db, const char* filename) : mDB(db), mVersion(VERSION_SDHD)
+	// UID -> resolved string, or the ~0x...~ fallback kept in mFallbackSymbols. After ExportParallel only the resolved ones of the sub-converters.
+
+	struct FallbackSymbol
+	{
+		char mStr[16];
+	};
+
+	std::unordered_map<u32, const char*> mSymbolCache;
+	std::deque<FallbackSymbol> mFallbackSymbols;
+	u64 mNumSymbolLookups = 0;
+	u64 mNumSymbolCacheHits = 0;
+
+	/* When set, the definition and every component are exported on the pool and merged in order. */
+	ThreadPool* mPool = 0;
+	TCStats* mStats = 0;
+
+	/*
+	*	The version comes from TCDatabaseLoader or the scriber, it is detected once where the resource size is known.
+	*	Output goes through SimpleXML::XMLWriter, -parallel, async writes and stdout included. The buffer writer formats
+	*	the file itself only for compact output.
+	*/
+	TCDatabaseConverter(TrueCrowdDataBase* db, ETCDatabaseVersion version, const char* filename, size_t bufferSize = 0x8000, bool asyncWrite = 0, bool compact = 0, ThreadPool* pool = 0)
+		: mDB(db), mVersion(version), mOwnsWriter(1), mPool(pool)
 	{
-		auto definition = &db->mDefinition;
-		if (definition->mComponentCount > 25) {
-			mVersion = VERSION_TW;
+		mXMLW = new XMLBufferWriter(0, compact);
+
+		if (compact) {
+			mIsOpen = mXMLW->Open(filename, bufferSize, asyncWrite);
+		}
+		else {
+			mIsOpen = mXMLW->OpenEngineWriter(filename, bufferSize, asyncWrite);
 		}
 
-		mXMLW = SimpleXML::XMLWriter::Create(filename, 0, 0x8000);
+		mTags = GetTags(mNumTags);
+	}
+
+	/* Exports into a writer owned by the caller, e.g. one without a file to keep the XML in memory. */
+	TCDatabaseConverter(TrueCrowdDataBase* db, ETCDatabaseVersion version, XMLBufferWriter* writer) : mDB(db), mVersion(version), mXMLW(writer), mOwnsWriter(0)
+	{
+		mTags = GetTags(mNumTags);
 	}
 
+	/* Exports into a writer owned by the caller. */
+	TCDatabaseConverter(const TCDatabaseConverter& parent, XMLBufferWriter* writer) : mDB(parent.mDB), mVersion(parent.mVersion), mTags(parent.mTags), mNumTags(parent.mNumTags), mXMLW(writer), mOwnsWriter(0) {}
+
 	~TCDatabaseConverter()
 	{
-		SimpleXML::XMLWriter::Close(mXMLW);
+		if (mOwnsWriter) {
+			delete mXMLW;
+		}
+
 		mXMLW = 0;
 	}
 
@@ -38,55 +86,86 @@ public:
 	//	Helpers
 	//------------------------------------
 
-	qString qSymbolStr(u32 uid)
+	const char* qSymbolStr(u32 uid)
 	{
-		if (auto str = qSymbolLookupStringFromSymbolTableResources(uid)) {
-			return str;
+		++mNumSymbolLookups;
+
+		auto it = mSymbolCache.find(uid);
+		if (it != mSymbolCache.end())
+		{
+			++mNumSymbolCacheHits;
+			return it->second;
 		}
 
-		mUnresolvedSymbols.insert(uid);
+		const char* str = TCSymbolDictionary::Lookup(uid);
+		if (!str)
+		{
+			mUnresolvedSymbols.insert(uid);
+
+			auto fallback = &mFallbackSymbols.emplace_back();
+			snprintf(fallback->mStr, sizeof(fallback->mStr), "~0x%08X~", uid);
+			str = fallback->mStr;
+		}
 
-		return { "~0x%08X~", uid };
+		mSymbolCache.emplace(uid, str);
+		return str;
 	}
 
-	qString FormatUID(u32 uid) { return { "0x%X", uid }; }
+	/* Stack formatted "0x%X" string. */
+	struct UIDString
+	{
+		char mStr[12];
+		u32 mLength;
 
-	TrueCrowdDefinition::Entity* GetEntities(u32& entityCount)
+		operator std::string_view() const { return { mStr, mLength }; }
+	};
+
+	UIDString FormatUID(u32 uid)
 	{
-		auto definition = &mDB->mDefinition;
+		UIDString str;
+		str.mLength = XMLBufferWriter::FormatHex(str.mStr, uid);
+		return str;
+	}
 
-		if (mVersion == VERSION_TW) {
-			definition = reinterpret_cast<TrueCrowdDefinition*>(reinterpret_cast<uptr>(definition) + 0xFC);
-		}
+	//------------------------------------
+	//	Layout
+	//------------------------------------
 
-		entityCount = definition->mEntityCount;
-		return definition->mEntities;
+	template <typename Layout>
+	TrueCrowdDefinition::Entity* GetEntities(u32& entityCount)
+	{
+		auto block = TCDatabaseLayout<Layout>::GetEntityBlock(mDB);
+		entityCount = block->mEntityCount;
+		return block->mEntities;
 	}
 
+	template <typename Layout>
 	qSymbol* GetTags(u32& numTags)
 	{
-		auto definition = &mDB->mDefinition;
-
-		if (mVersion == VERSION_TW) {
-			definition = reinterpret_cast<TrueCrowdDefinition*>(reinterpret_cast<uptr>(definition) + 0x2450);
-		}
-
-		numTags = definition->mNumTags;
-		return definition->mTagList.Get();
+		auto block = TCDatabaseLayout<Layout>::GetTagBlock(mDB);
+		numTags = block->mNumTags;
+		return block->mTagList.Get();
 	}
 
+	template <typename Layout>
 	TrueCrowdDataBase::ComponentEntries* GetComponentEntries(u32& numComponentEntries)
 	{
-		auto db = mDB;
+		auto block = TCDatabaseLayout<Layout>::GetComponentEntryBlock(mDB);
+		numComponentEntries = block->mNumComponentEntries;
+		return block->mComponentEntries.Get();
+	}
 
-		if (mVersion == VERSION_TW) {
-			db = reinterpret_cast<TrueCrowdDataBase*>(reinterpret_cast<uptr>(db) + 0x2450);
-		}
+	TrueCrowdDefinition::Entity* GetEntities(u32& entityCount) { return (mVersion == TCDB_VERSION_TW ? GetEntities<TCLayoutTW>(entityCount) : GetEntities<TCLayoutSDHD>(entityCount)); }
 
-		numComponentEntries = db->mNumComponentEntries;
-		return db->mComponentEntries.Get();
+	qSymbol* GetTags(u32& numTags) { return (mVersion == TCDB_VERSION_TW ? GetTags<TCLayoutTW>(numTags) : GetTags<TCLayoutSDHD>(numTags)); }
+
+	TrueCrowdDataBase::ComponentEntries* GetComponentEntries(u32& numComponentEntries)
+	{
+		return (mVersion == TCDB_VERSION_TW ? GetComponentEntries<TCLayoutTW>(numComponentEntries) : GetComponentEntries<TCLayoutSDHD>(numComponentEntries));
 	}
 
+	TrueCrowdDefinition::Component* GetComponents() { return TCDatabaseLayout<TCLayoutSDHD>::GetComponents(mDB); }
+
 	//------------------------------------
 	//	Tags
 	//------------------------------------
@@ -103,10 +182,9 @@ public:
 
 	void ExportTags(const BitFlags128& bitFlags)
 	{
-		u32 numTags;
-		auto tag = GetTags(numTags);
+		auto tag = mTags;
 
-		for (u32 i = 0; numTags > i; ++i, ++tag)
+		for (u32 i = 0; mNumTags > i; ++i, ++tag)
 		{
 			if (!bitFlags.IsSet(i)) {
 				continue;
@@ -161,14 +239,15 @@ public:
 	}
 
 
-	void ExportDefinition(TrueCrowdDefinition* definition)
+	template <typename Layout>
+	void ExportDefinition()
 	{
 		mXMLW->BeginNode(XTag_Definition);
 
 		// Entites
 
 		u32 entityCount;
-		auto entities = GetEntities(entityCount);
+		auto entities = GetEntities<Layout>(entityCount);
 		for (u32 i = 0; entityCount > i; ++i) {
 			ExportEntity(&entities[i]);
 		}
@@ -177,9 +256,7 @@ public:
 
 		mXMLW->BeginNode(XTag_Tags);
 
-		u32 numTags = 0;
-		auto tags = GetTags(numTags);
-		ExportTags(tags, numTags);
+		ExportTags(mTags, mNumTags);
 
 		mXMLW->EndNode(XTag_Tags);
 
@@ -321,50 +398,177 @@ public:
 		}
 	}
 
+	void ExportComponentEntry(TrueCrowdDataBase::ComponentEntries* entry, u32 index)
+	{
+		mXMLW->BeginNode(XTag_Component);
+
+		mXMLW->AddAttribute(XAttr_Name, GetComponents()[index].mName);
+
+		ExportResourceEntries(entry->mEntries.Get(), entry->mNumEntries);
+
+		mXMLW->EndNode(XTag_Component);
+	}
+
 	void ExportComponentEntries(TrueCrowdDataBase::ComponentEntries* entries, u32 count)
 	{
 		if (!entries || !count) {
 			return;
 		}
 
-		for (u32 i = 0; count > i; ++i)
+		for (u32 i = 0; count > i; ++i) {
+			ExportComponentEntry(&entries[i], i);
+		}
+	}
+
+	/* Records the definition and each component on the pool, then replays the recordings in document order into mXMLW. */
+	template <typename Layout>
+	void ExportParallel(TrueCrowdDataBase::ComponentEntries* entries, u32 count)
+	{
+		if (!entries) {
+			count = 0;
+		}
+
+		std::vector<std::unique_ptr<XMLBufferWriter>> writers;
+		std::vector<std::unique_ptr<TCDatabaseConverter>> converters;
+
+		for (u32 i = 0; count + 1 > i; ++i)
 		{
-			mXMLW->BeginNode(XTag_Component);
+			writers.emplace_back(new XMLBufferWriter());
+			writers.back()->mRecord = 1;
+			converters.emplace_back(new TCDatabaseConverter(*this, writers.back().get()));
+		}
 
-			mXMLW->AddAttribute(XAttr_Name, mDB->mDefinition.mComponents[i].mName);
+		mPool->ParallelFor(count + 1, [&](u32 i)
+		{
+			if (!i) {
+				converters[i]->template ExportDefinition<Layout>();
+			}
+			else {
+				converters[i]->ExportComponentEntry(&entries[i - 1], i - 1);
+			}
+		});
 
-			auto entry = &entries[i];
-			ExportResourceEntries(entry->mEntries.Get(), entry->mNumEntries);
+		mXMLW->BeginNode(XTag_TCDB);
+		mXMLW->AppendWriter(*writers[0]);
+
+		mXMLW->BeginNode(XTag_ComponentEntries);
+		for (u32 i = 1; count + 1 > i; ++i) {
+			mXMLW->AppendWriter(*writers[i]);
+		}
+		mXMLW->EndNode(XTag_ComponentEntries);
+
+		mXMLW->EndNode(XTag_TCDB);
 
-			mXMLW->EndNode(XTag_Component);
+		for (auto& converter : converters)
+		{
+			mUnresolvedSymbols.insert(converter->mUnresolvedSymbols.begin(), converter->mUnresolvedSymbols.end());
+
+			/* Fallback strings live in the sub-converter, only resolved ones are kept. */
+			for (auto& symbol : converter->mSymbolCache)
+			{
+				if (!converter->mUnresolvedSymbols.count(symbol.first)) {
+					mSymbolCache.insert(symbol);
+				}
+			}
+
+			mNumSymbolLookups += converter->mNumSymbolLookups;
+			mNumSymbolCacheHits += converter->mNumSymbolCacheHits;
 		}
 	}
 
-	void Export()
+	void PrintSymbolCacheStats()
 	{
-		mXMLW->BeginNode(XTag_TCDB);
+		const double hitRate = (mNumSymbolLookups ? 100.0 * mNumSymbolCacheHits / mNumSymbolLookups : 0.0);
+		qPrintf("Symbol cache: %llu lookups, %llu hits (%.1f%%), %llu unresolved.\n", static_cast<unsigned long long>(mNumSymbolLookups),
+			static_cast<unsigned long long>(mNumSymbolCacheHits), hitRate, static_cast<unsigned long long>(mUnresolvedSymbols.size()));
+	}
 
-		ExportDefinition(&mDB->mDefinition);
+	void ExportUnresolvedSymbols()
+	{
+		if (mUnresolvedSymbols.empty()) {
+			return;
+		}
 
-		mXMLW->BeginNode(XTag_ComponentEntries);
+		mXMLW->AddComment(" List of unresolved symbols ");
+
+		for (auto uid : mUnresolvedSymbols)
 		{
-			u32 numComponentEntries = 0;
-			auto componentEntries = GetComponentEntries(numComponentEntries);
-			ExportComponentEntries(GetComponentEntries(numComponentEntries), numComponentEntries);
+			char str[16] = { ' ' };
+			u32 len = XMLBufferWriter::FormatHex(&str[1], uid) + 1;
+			str[len++] = ' ';
+
+			mXMLW->AddComment(std::string_view(str, len));
 		}
-		mXMLW->EndNode(XTag_ComponentEntries);
+	}
 
-		mXMLW->EndNode(XTag_TCDB);
+	template <typename Layout>
+	void Export()
+	{
+		u32 numComponentEntries = 0;
+		auto componentEntries = GetComponentEntries<Layout>(numComponentEntries);
 
-		if (!mUnresolvedSymbols.empty())
+		if (mPool)
+		{
+			TCStats::ScopedPhase phase(mStats, "export_parallel");
+			ExportParallel<Layout>(componentEntries, numComponentEntries);
+		}
+		else
 		{
-			mXMLW->AddComment(" List of unresolved symbols ");
+			mXMLW->BeginNode(XTag_TCDB);
 
-			for (auto uid : mUnresolvedSymbols)
 			{
-				qString str = { " 0x%X ", uid };
-				mXMLW->AddComment(str);
+				TCStats::ScopedPhase phase(mStats, "export_definition");
+				ExportDefinition<Layout>();
 			}
+
+			{
+				TCStats::ScopedPhase phase(mStats, "export_component_entries");
+
+				mXMLW->BeginNode(XTag_ComponentEntries);
+				ExportComponentEntries(componentEntries, numComponentEntries);
+				mXMLW->EndNode(XTag_ComponentEntries);
+			}
+
+			mXMLW->EndNode(XTag_TCDB);
 		}
+
+		TCStats::ScopedPhase phase(mStats, "export_unresolved_symbols");
+		ExportUnresolvedSymbols();
+	}
+
+	bool Export()
+	{
+		if (!mIsOpen) {
+			return 0;
+		}
+
+		if (mVersion == TCDB_VERSION_TW) {
+			Export<TCLayoutTW>();
+		}
+		else {
+			Export<TCLayoutSDHD>();
+		}
+
+		return 1;
+	}
+
+	/* Closes the writer, call after Export. */
+	void AddStats(TCStats& stats)
+	{
+		auto start = TCStats::Clock::now();
+		mXMLW->Close();
+		stats.AddPhase("writer_close", start);
+		stats.AddPhase("writer_flush", TCStats::ToMilliseconds(mXMLW->mFlushTime));
+
+		stats.SetCounter("nodes_emitted", mXMLW->mNumNodes);
+		stats.SetCounter("output_bytes", mXMLW->mNumBytesWritten);
+		stats.SetCounter("symbol_lookups", mNumSymbolLookups);
+		u64 numResolvedSymbols = 0;
+		for (auto& symbol : mSymbolCache) {
+			numResolvedSymbols += !mUnresolvedSymbols.count(symbol.first);
+		}
+
+		stats.SetCounter("symbols_resolved", numResolvedSymbols);
+		stats.SetCounter("symbols_unresolved", mUnresolvedSymbols.size());
 	}
 };
\ No newline at end of file
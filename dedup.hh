@@ -0,0 +1,82 @@
+#pragma once
+#include "arena.hh"
+#include "cache.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Content addressed table used by the scriber to share identical arrays and structs.
+///
+///		Keys are the bytes the content is written as, so equal keys can point at one copy.
+///		The counting pass inserts every key and only new ones are sized in the schema, the
+///		build pass finds the entry again and stores the written copy in mShared.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCDedupTable
+{
+public:
+	static constexpr u32 InvalidIndex = ~0u;
+
+	struct Entry
+	{
+		u32 mKeyOffset;
+		u32 mKeySize;
+		u32 mNext;
+		void* mShared;
+	};
+
+	TCArenaVector<u8> mKeys;
+	TCArenaVector<Entry> mEntries;
+
+	/* Key hash -> first entry, colliding entries are chained through mNext. */
+	TCArenaHashMap<u64, u32> mBuckets;
+
+	TCDedupTable(TCArena* arena = 0) : mKeys(TCArenaAllocator<u8>(arena)), mEntries(TCArenaAllocator<Entry>(arena)), mBuckets(TCArenaAllocator<std::pair<const u64, u32>>(arena)) {}
+
+	static u64 HashKey(const void* key, u32 size)
+	{
+		TCDatabaseCache::Hash hash;
+		hash.Add(key, size);
+		return hash.mValue;
+	}
+
+	u32 Find(const void* key, u32 size, u64 hash) const
+	{
+		auto it = mBuckets.find(hash);
+		for (u32 i = (it != mBuckets.end() ? it->second : InvalidIndex); i != InvalidIndex; i = mEntries[i].mNext)
+		{
+			auto& entry = mEntries[i];
+			if (entry.mKeySize == size && !memcmp(&mKeys[entry.mKeyOffset], key, size)) {
+				return i;
+			}
+		}
+
+		return InvalidIndex;
+	}
+
+	u32 Find(const void* key, u32 size) const { return Find(key, size, HashKey(key, size)); }
+
+	/* Returns the index of the entry with this key, isNew tells whether it was added by this call. */
+	u32 Insert(const void* key, u32 size, bool& isNew)
+	{
+		const u64 hash = HashKey(key, size);
+
+		u32 index = Find(key, size, hash);
+		isNew = (index == InvalidIndex);
+		if (!isNew) {
+			return index;
+		}
+
+		index = static_cast<u32>(mEntries.size());
+
+		auto bucket = mBuckets.emplace(hash, index);
+		mEntries.push_back({ static_cast<u32>(mKeys.size()), size, (bucket.second ? InvalidIndex : bucket.first->second), 0 });
+		bucket.first->second = index;
+
+		auto bytes = static_cast<const u8*>(key);
+		mKeys.insert(mKeys.end(), bytes, bytes + size);
+		return index;
+	}
+};
@@ -0,0 +1,326 @@
+#pragma once
+#include "xmlwriter.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Synthetic TrueCrowdDataBase XML generator.
+///
+///		Writes a valid database with the requested number of elements, names are unique and
+///		HighResolutionResource references always point at an earlier resource, so the output
+///		scribes without warnings. The same options and seed always give the same file.
+///
+///		Counts are per parent (resources per component, LODs per resource, ...) and are
+///		clamped to the fixed size arrays of TrueCrowdDefinition and to the 128 tag bits.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct TCGeneratorOptions
+{
+	u32 mNumComponents = 25;
+	u32 mNumResources = 8;
+	u32 mNumLODs = 3;
+	u32 mNumModelParts = 4;
+	u32 mNumTextureSets = 2;
+	u32 mNumColourTints = 2;
+	u32 mNumOverrideParams = 2;
+	u32 mNumTags = 64;
+	u32 mNumResourceTags = 3;
+	u32 mNumEntities = 16;
+	u32 mSeed = 1;
+
+	/* Comma separated key=value list, e.g. "components=10,resources=100". */
+	bool Parse(const char* spec)
+	{
+		struct Option
+		{
+			const char* mName;
+			u32* mValue;
+		};
+
+		const Option options[] =
+		{
+			{ "components", &mNumComponents },
+			{ "resources", &mNumResources },
+			{ "lods", &mNumLODs },
+			{ "parts", &mNumModelParts },
+			{ "texturesets", &mNumTextureSets },
+			{ "tints", &mNumColourTints },
+			{ "params", &mNumOverrideParams },
+			{ "tags", &mNumTags },
+			{ "resourcetags", &mNumResourceTags },
+			{ "entities", &mNumEntities },
+			{ "seed", &mSeed },
+		};
+
+		while (*spec)
+		{
+			const char* end = spec;
+			while (*end && *end != ',') {
+				++end;
+			}
+
+			const char* equals = spec;
+			while (equals < end && *equals != '=') {
+				++equals;
+			}
+
+			bool found = 0;
+			if (equals < end)
+			{
+				for (auto& option : options)
+				{
+					if (qStringLength(option.mName) == equals - spec && !strncmp(option.mName, spec, equals - spec))
+					{
+						*option.mValue = static_cast<u32>(strtoul(equals + 1, 0, 0));
+						found = 1;
+						break;
+					}
+				}
+			}
+
+			if (!found)
+			{
+				qPrintf("ERROR: Unknown generator option %.*s.\n", static_cast<int>(end - spec), spec);
+				return 0;
+			}
+
+			spec = (*end ? end + 1 : end);
+		}
+
+		return 1;
+	}
+};
+
+class TCDatabaseGenerator
+{
+public:
+	static constexpr u32 MaxComponents = sizeof(TrueCrowdDefinition::mComponents) / sizeof(TrueCrowdDefinition::Component);
+	static constexpr u32 MaxEntities = sizeof(TrueCrowdDefinition::mEntities) / sizeof(TrueCrowdDefinition::Entity);
+	static constexpr u32 MaxEntityComponents = sizeof(TrueCrowdDefinition::Entity::mComponents) / sizeof(TrueCrowdDefinition::Entity::EntityComponent);
+	static constexpr u32 MaxBoneUIDs = sizeof(TrueCrowdDefinition::Entity::EntityComponent::mBoneUID) / sizeof(qSymbol);
+	static constexpr u32 MaxTags = 128;
+	static constexpr u32 NumModelPartNames = 256;
+
+	TCGeneratorOptions mOptions;
+	XMLBufferWriter mXMLW;
+	u32 mRandom;
+
+	TCDatabaseGenerator(const TCGeneratorOptions& options) : mOptions(options), mRandom(options.mSeed ? options.mSeed : 1)
+	{
+		Clamp(mOptions.mNumComponents, MaxComponents, "components");
+		Clamp(mOptions.mNumEntities, MaxEntities, "entities");
+		Clamp(mOptions.mNumTags, MaxTags, "tags");
+		Clamp(mOptions.mNumResourceTags, mOptions.mNumTags, "resourcetags");
+	}
+
+	static void Clamp(u32& value, u32 max, const char* name)
+	{
+		if (value > max)
+		{
+			qPrintf("WARN: Generator option %s is limited to %u.\n", name, max);
+			value = max;
+		}
+	}
+
+	/* xorshift32 */
+	u32 Random()
+	{
+		mRandom ^= mRandom << 13;
+		mRandom ^= mRandom >> 17;
+		mRandom ^= mRandom << 5;
+		return mRandom;
+	}
+
+	u32 Random(u32 max) { return (max ? Random() % max : 0); }
+
+	//------------------------------------
+	//	Generate
+	//------------------------------------
+
+	void GenerateEntity(u32 index)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "Entity%u", index);
+
+		mXMLW.BeginNode(XTag_Entity);
+		mXMLW.AddAttribute(XAttr_Name, name);
+
+		const u32 numComponents = (mOptions.mNumComponents < MaxEntityComponents ? mOptions.mNumComponents : MaxEntityComponents);
+		for (u32 i = 0; numComponents > i; ++i)
+		{
+			snprintf(name, sizeof(name), "Component%u", i);
+
+			mXMLW.BeginNode(XTag_EntityComponent);
+			mXMLW.AddAttribute(XAttr_Name, name);
+			mXMLW.AddAttribute(XAttr_ResourceIndex, Random(mOptions.mNumResources));
+			mXMLW.AddAttribute(XAttr_Required, static_cast<u32>(i == 0));
+
+			const u32 numBoneUIDs = 1 + Random(MaxBoneUIDs < 4 ? MaxBoneUIDs : 4);
+			for (u32 j = 0; numBoneUIDs > j; ++j)
+			{
+				snprintf(name, sizeof(name), "Bip01_Bone%u", Random(64));
+
+				mXMLW.BeginNode(XTag_BoneUID);
+				mXMLW.AddValue(name);
+				mXMLW.EndNode(XTag_BoneUID);
+			}
+
+			mXMLW.EndNode(XTag_EntityComponent);
+		}
+
+		mXMLW.EndNode(XTag_Entity);
+	}
+
+	void GenerateTextureSet(u32 component, u32 resource, u32 index)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "Component%u_Resource%u_TextureSet%u", component, resource, index);
+
+		mXMLW.BeginNode(XTag_TextureSet);
+		mXMLW.AddAttribute(XAttr_Name, name);
+
+		if (index && !Random(4))
+		{
+			snprintf(name, sizeof(name), "Component%u_Resource%u_TextureSet%u", component, resource, index - 1);
+
+			mXMLW.BeginNode(XTag_HighResolutionResource);
+			mXMLW.AddAttribute(XAttr_Name, name);
+			mXMLW.EndNode(XTag_HighResolutionResource);
+		}
+
+		for (u32 i = 0; mOptions.mNumColourTints > i; ++i)
+		{
+			mXMLW.BeginNode(XTag_ColourTint);
+			mXMLW.AddAttribute("r", Random(256));
+			mXMLW.AddAttribute("g", Random(256));
+			mXMLW.AddAttribute("b", Random(256));
+			mXMLW.EndNode(XTag_ColourTint);
+		}
+
+		for (u32 i = 0; mOptions.mNumOverrideParams > i; ++i)
+		{
+			char sampler[32];
+			snprintf(sampler, sizeof(sampler), "Sampler%u", i);
+
+			char uid[16];
+
+			mXMLW.BeginNode(XTag_OverrideParam);
+			mXMLW.AddAttribute(XAttr_Sampler, sampler);
+			mXMLW.AddAttribute(XAttr_NameUID, std::string_view(uid, XMLBufferWriter::FormatHex(uid, Random())));
+			mXMLW.AddAttribute(XAttr_UID0, std::string_view(uid, XMLBufferWriter::FormatHex(uid, Random())));
+			mXMLW.AddAttribute(XAttr_UID1, std::string_view(uid, XMLBufferWriter::FormatHex(uid, Random())));
+			mXMLW.AddAttribute(XAttr_UID2, std::string_view(uid, XMLBufferWriter::FormatHex(uid, Random())));
+			mXMLW.EndNode(XTag_OverrideParam);
+		}
+
+		mXMLW.EndNode(XTag_TextureSet);
+	}
+
+	void GenerateResource(u32 component, u32 index)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "Component%u_Resource%u", component, index);
+
+		mXMLW.BeginNode(XTag_Resource);
+		mXMLW.AddAttribute(XAttr_Name, name);
+		mXMLW.AddAttribute(XAttr_Type, Random(3));
+
+		if (index && !Random(4))
+		{
+			snprintf(name, sizeof(name), "Component%u_Resource%u", component, Random(index));
+
+			mXMLW.BeginNode(XTag_HighResolutionResource);
+			mXMLW.AddAttribute(XAttr_Name, name);
+			mXMLW.EndNode(XTag_HighResolutionResource);
+		}
+
+		for (u32 i = 0; mOptions.mNumLODs > i; ++i)
+		{
+			mXMLW.BeginNode(XTag_LOD);
+
+			for (u32 j = 0; mOptions.mNumModelParts > j; ++j)
+			{
+				snprintf(name, sizeof(name), "ModelPart%u", Random(NumModelPartNames));
+
+				mXMLW.BeginNode(XTag_ModelPart);
+				mXMLW.AddAttribute(XAttr_Name, name);
+				mXMLW.AddAttribute(XAttr_IsSkinned, Random(2));
+				mXMLW.AddAttribute(XAttr_MorphType, Random(4));
+				mXMLW.EndNode(XTag_ModelPart);
+			}
+
+			mXMLW.EndNode(XTag_LOD);
+		}
+
+		for (u32 i = 0; mOptions.mNumTextureSets > i; ++i) {
+			GenerateTextureSet(component, index, i);
+		}
+
+		/* Consecutive tags from a random start, so they never repeat. */
+		const u32 firstTag = Random(mOptions.mNumTags);
+		for (u32 i = 0; mOptions.mNumResourceTags > i; ++i)
+		{
+			snprintf(name, sizeof(name), "Tag%u", (firstTag + i) % mOptions.mNumTags);
+
+			mXMLW.BeginNode(XTag_Tag);
+			mXMLW.AddValue(name);
+			mXMLW.EndNode(XTag_Tag);
+		}
+
+		mXMLW.EndNode(XTag_Resource);
+	}
+
+	bool Generate(const char* filename)
+	{
+		if (!mXMLW.Open(filename)) {
+			return 0;
+		}
+
+		mXMLW.BeginNode(XTag_TCDB);
+		mXMLW.BeginNode(XTag_Definition);
+
+		for (u32 i = 0; mOptions.mNumEntities > i; ++i) {
+			GenerateEntity(i);
+		}
+
+		mXMLW.BeginNode(XTag_Tags);
+
+		for (u32 i = 0; mOptions.mNumTags > i; ++i)
+		{
+			char name[16];
+			snprintf(name, sizeof(name), "Tag%u", i);
+
+			mXMLW.BeginNode(XTag_Tag);
+			mXMLW.AddValue(name);
+			mXMLW.EndNode(XTag_Tag);
+		}
+
+		mXMLW.EndNode(XTag_Tags);
+		mXMLW.EndNode(XTag_Definition);
+
+		mXMLW.BeginNode(XTag_ComponentEntries);
+
+		for (u32 i = 0; mOptions.mNumComponents > i; ++i)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "Component%u", i);
+
+			mXMLW.BeginNode(XTag_Component);
+			mXMLW.AddAttribute(XAttr_Name, name);
+
+			for (u32 j = 0; mOptions.mNumResources > j; ++j) {
+				GenerateResource(i, j);
+			}
+
+			mXMLW.EndNode(XTag_Component);
+		}
+
+		mXMLW.EndNode(XTag_ComponentEntries);
+		mXMLW.EndNode(XTag_TCDB);
+
+		mXMLW.Close();
+		return 1;
+	}
+};
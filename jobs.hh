@@ -0,0 +1,387 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "verify.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Single file conversion jobs shared by the command line, batch mode and later front-ends.
+///		The symbol table is loaded once by the caller.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct TCJobOptions
+{
+	bool mStreaming = 0;
+	bool mNoMapping = 0;
+	bool mParallel = 0;
+	bool mIncremental = 0;
+	bool mVerbose = 0;
+	bool mStats = 0;
+
+	/* XML output of converter jobs. */
+	bool mCompact = 0;
+	bool mAsyncWrite = 0;
+	size_t mWriteBufferSize = 0x8000;
+
+	/* Layout written by scribe jobs. */
+	ETCDatabaseVersion mScribeVersion = TCDB_VERSION_SDHD;
+
+	/* Share identical names in the scribed StringBuffer, not applied to mIncremental builds. */
+	bool mPoolStrings = 0;
+
+	/* Share identical texture sets, colour tint and override param arrays, not applied to mIncremental builds either. */
+	bool mDedup = 0;
+
+	/* Output file instead of the one derived from the input, - writes to stdout. Single file jobs only. */
+	const char* mOutput = 0;
+
+	/* Time main spent loading the symbol table, reported by every -stats conversion. */
+	double mSymbolTableLoadTime = 0.0;
+
+	/* Pool used by mParallel, converter and scribe jobs split their components over it. */
+	ThreadPool* mPool = 0;
+
+	/*
+	*	mPool also runs other jobs (batch mode). Scribe jobs then build their components serially, the other workers
+	*	are busy with jobs of their own that queue on the schema mutex held while building.
+	*/
+	bool mSharedPool = 0;
+};
+
+typedef bool (*TCJobFunction)(const qString& filename, const TCJobOptions& options);
+
+/* An input read from stdin is written to stdout unless mOutput says otherwise. */
+inline qString GetOutputFilename(const qString& filename, const char* extension, const TCJobOptions& options)
+{
+	if (options.mOutput) {
+		return options.mOutput;
+	}
+
+	if (IsStdStream(filename)) {
+		return filename;
+	}
+
+	return filename.GetFilePathWithoutExtension() + extension;
+}
+
+inline bool ConvertFile(const qString& filename, const TCJobOptions& options)
+{
+	TCStats stats;
+	auto start = TCStats::Clock::now();
+
+	TCDatabaseLoader loader;
+	if (!loader.Load(filename, !options.mNoMapping)) {
+		return 0;
+	}
+
+	stats.AddPhase("load", start);
+	stats.AddPhase("symbol_table_load", options.mSymbolTableLoadTime);
+
+	auto xmlFilename = GetOutputFilename(filename, ".xml", options);
+	TCDatabaseConverter converter = { loader.mDB, loader.mVersion, xmlFilename, options.mWriteBufferSize, options.mAsyncWrite, options.mCompact, (options.mParallel ? options.mPool : 0) };
+	converter.mStats = (options.mStats ? &stats : 0);
+
+#ifdef TCDB_COUNT_ALLOCATIONS
+	const u64 numAllocations = GetNumHeapAllocations();
+#endif
+	if (!converter.Export()) {
+		return 0;
+	}
+
+	if (options.mVerbose)
+	{
+		converter.PrintSymbolCacheStats();
+
+#ifdef TCDB_COUNT_ALLOCATIONS
+		qPrintf("Heap allocations: %llu during export of %llu nodes.\n", GetNumHeapAllocations() - numAllocations, converter.mXMLW->mNumNodes);
+#endif
+	}
+
+	if (options.mStats)
+	{
+		converter.AddStats(stats);
+
+		stats.mPipeline = "conv";
+		stats.mInput = filename.mData;
+		stats.mOutput = xmlFilename.mData;
+		stats.SetCounter("peak_memory_bytes", GetPeakMemoryUsage());
+		stats.Write(xmlFilename + ".stats.json");
+	}
+
+	qPrintf("File has been exported to: %s\n", xmlFilename.mData);
+	return 1;
+}
+
+inline bool ScribeFile(const qString& filename, const TCJobOptions& options)
+{
+	TCStats stats;
+	auto start = TCStats::Clock::now();
+
+	/* Everything the scriber allocates for this job goes back to the thread's arena at once. */
+	TCArenaScope arenaScope = { &TCArena::GetThreadArena() };
+
+	/* The incremental cache is keyed on staged components and stdin can only be read once, so both take the streaming path. */
+	TCDatabaseScriber scriber = { filename, (options.mStreaming || options.mIncremental || IsStdStream(filename) ? TCXML_PARSER_STREAM : TCXML_PARSER_DOCUMENT), arenaScope.mArena };
+	if (!scriber.IsLoaded()) {
+		return 0;
+	}
+
+	stats.AddPhase("xml_parse", start);
+	scriber.mStats = (options.mStats ? &stats : 0);
+	scriber.mVersion = options.mScribeVersion;
+
+	/* Cached components carry their own string slice, pooling across them would leave dangling offsets. */
+	scriber.mPoolStrings = (options.mPoolStrings && !options.mIncremental);
+	scriber.mDedup = (options.mDedup && !options.mIncremental);
+	scriber.mPool = (options.mParallel && !options.mSharedPool ? options.mPool : 0);
+
+	TCDatabaseCache cache;
+	auto cacheFilename = filename.GetFilePathWithoutExtension() + ".tccache";
+
+	if (options.mIncremental)
+	{
+		TCStats::ScopedPhase phase(scriber.mStats, "cache_load");
+
+		cache.Load(cacheFilename);
+		scriber.mCache = &cache;
+	}
+
+	if (!scriber.Build()) {
+		return 0;
+	}
+
+	auto binFilename = GetOutputFilename(filename, ".bin", options);
+
+	/* A chunk written to stdout has its symbols next to the input, they are skipped if that is piped too. */
+	qString qSymbolsFilename = filename.GetFilePathWithoutExtension() + "_qsymbols.txt";
+	const char* exportQSymbolsFilename = 0;
+
+	if (IsStdStream(binFilename)) {
+		exportQSymbolsFilename = (IsStdStream(filename) ? "" : qSymbolsFilename.mData);
+	}
+
+	scriber.Export(binFilename, exportQSymbolsFilename);
+	scriber.ReleaseSchema();
+
+	if (options.mIncremental)
+	{
+		TCStats::ScopedPhase phase(scriber.mStats, "cache_save");
+		scriber.SaveCache(cacheFilename);
+	}
+
+	if (options.mStats)
+	{
+		scriber.AddStats(stats);
+
+		stats.mPipeline = "scribe";
+		stats.mInput = filename.mData;
+		stats.mOutput = binFilename.mData;
+		stats.SetCounter("peak_memory_bytes", GetPeakMemoryUsage());
+		stats.Write(binFilename + ".stats.json");
+	}
+
+	return 1;
+}
+
+/* Converts to a temporary file the way ConvertFile would with the given pool and write mode, and compares it with reference. */
+inline bool VerifyConversionMatches(const TCDatabaseLoader& loader, const qString& filename, const TCJobOptions& options, const std::string& reference, const char* variant, ThreadPool* pool, bool asyncWrite)
+{
+	const std::string xmlFilename = GetTempFilename(".xml");
+
+	bool result;
+	{
+		TCDatabaseConverter converter = { loader.mDB, loader.mVersion, xmlFilename.c_str(), options.mWriteBufferSize, asyncWrite, options.mCompact, pool };
+		result = converter.Export();
+	}
+
+	if (result && !FilesEqual(reference.c_str(), xmlFilename.c_str()))
+	{
+		qPrintf("ERROR: Verify of %s failed, the %s conversion differs from the serial one.\n", filename.mData, variant);
+		result = 0;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(xmlFilename, ec);
+	return result;
+}
+
+/* Scribes the converted XML with parser like ScribeFile would and compares the result with the loaded database. */
+inline bool VerifyScribe(const TCDatabaseLoader& loader, const qString& filename, const TCJobOptions& options, const std::string& xmlFilename, ETCXMLParser parser, bool printSummary)
+{
+	const char* parserName = (parser == TCXML_PARSER_STREAM ? "the -stream parser" : "SimpleXML");
+
+	TCArenaScope arenaScope = { &TCArena::GetThreadArena() };
+
+	TCDatabaseScriber scriber = { xmlFilename.c_str(), parser, arenaScope.mArena };
+	if (!scriber.IsLoaded())
+	{
+		qPrintf("ERROR: Verify of %s failed, the converted XML could not be parsed by %s.\n", filename.mData, parserName);
+		return 0;
+	}
+
+	scriber.mVersion = loader.mVersion;
+	scriber.mPoolStrings = options.mPoolStrings;
+	scriber.mDedup = options.mDedup;
+
+	if (!scriber.Build())
+	{
+		qPrintf("ERROR: Verify of %s failed, the converted XML could not be scribed with %s.\n", filename.mData, parserName);
+		return 0;
+	}
+
+	TCDatabaseVerifier verifier = { loader.mDB, scriber.mDB, loader.mVersion };
+	if (!verifier.Verify())
+	{
+		qPrintf("ERROR: Verify of %s failed with %s at %s\n", filename.mData, parserName, verifier.mDifference.c_str());
+		return 0;
+	}
+
+	if (printSummary) {
+		verifier.PrintSummary();
+	}
+
+	return 1;
+}
+
+/*
+*	Converts to a temporary XML file with the writer of ConvertFile, scribes it back with both the default and the -stream
+*	parser and compares each result with the input. -parallel and -asyncwrite conversions have to write the same bytes.
+*/
+inline bool VerifyFile(const qString& filename, const TCJobOptions& options)
+{
+	TCDatabaseLoader loader;
+	if (!loader.Load(filename, !options.mNoMapping)) {
+		return 0;
+	}
+
+	const std::string xmlFilename = GetTempFilename(".xml");
+
+	bool result;
+	{
+		TCDatabaseConverter converter = { loader.mDB, loader.mVersion, xmlFilename.c_str(), options.mWriteBufferSize, 0, options.mCompact };
+		result = converter.Export();
+	}
+
+	if (!result) {
+		qPrintf("ERROR: Verify of %s failed, the database could not be converted.\n", filename.mData);
+	}
+
+	if (result && options.mParallel && options.mPool) {
+		result = VerifyConversionMatches(loader, filename, options, xmlFilename, "-parallel", options.mPool, 0);
+	}
+
+	if (result && options.mAsyncWrite) {
+		result = VerifyConversionMatches(loader, filename, options, xmlFilename, "-asyncwrite", 0, 1);
+	}
+
+	result = result && VerifyScribe(loader, filename, options, xmlFilename, TCXML_PARSER_DOCUMENT, options.mVerbose) && VerifyScribe(loader, filename, options, xmlFilename, TCXML_PARSER_STREAM, 0);
+
+	std::error_code ec;
+	std::filesystem::remove(xmlFilename, ec);
+
+	if (result) {
+		qPrintf("Verify of %s passed.\n", filename.mData);
+	}
+
+	return result;
+}
+
+//------------------------------------
+//	Buffer Jobs
+//------------------------------------
+
+/* Line of the _qsymbols.txt file written next to a scribed file. */
+struct TCSymbolEntry
+{
+	u32 mUID;
+	std::string mName;
+};
+
+/*
+*	Binary chunk to XML, bin is read in place when it is u64 aligned. The XML is written by SimpleXML::XMLWriter into a
+*	temporary file like ConvertFile would, only -compact output is formatted in memory.
+*/
+inline bool ConvertBuffer(const void* bin, size_t binSize, std::vector<char>& xml, const TCJobOptions& options = TCJobOptions())
+{
+	TCDatabaseLoader loader;
+	if (!loader.Load(bin, binSize, "<buffer>")) {
+		return 0;
+	}
+
+	ThreadPool* pool = (options.mParallel ? options.mPool : 0);
+
+	if (options.mCompact)
+	{
+		XMLBufferWriter writer = { 0, 1 };
+		{
+			TCDatabaseConverter converter = { loader.mDB, loader.mVersion, &writer };
+			converter.mPool = pool;
+
+			if (!converter.Export()) {
+				return 0;
+			}
+		}
+
+		xml.swap(writer.mBuffer);
+		return 1;
+	}
+
+	const std::string xmlFilename = GetTempFilename(".xml");
+
+	bool result;
+	{
+		TCDatabaseConverter converter = { loader.mDB, loader.mVersion, xmlFilename.c_str(), options.mWriteBufferSize, options.mAsyncWrite, 0, pool };
+		result = converter.Export();
+	}
+
+	result = result && ReadEntireFile(xmlFilename.c_str(), xml);
+
+	std::error_code ec;
+	std::filesystem::remove(xmlFilename, ec);
+	return result;
+}
+
+/* XML to a binary chunk and its symbols, the XML is parsed in a single streaming pass. The chunk is laid out by qChunkFileBuilder in a temporary file. */
+inline bool ScribeBuffer(const void* xml, size_t xmlSize, std::vector<u8>& bin, std::vector<TCSymbolEntry>* symbols, const TCJobOptions& options = TCJobOptions())
+{
+	TCArenaScope arenaScope = { &TCArena::GetThreadArena() };
+
+	auto stage = new TCDatabaseStage(arenaScope.mArena);
+	if (!stage->Open(xml, xmlSize))
+	{
+		delete stage;
+		return 0;
+	}
+
+	TCDatabaseScriber scriber = { stage };
+	scriber.mVersion = options.mScribeVersion;
+	scriber.mPoolStrings = options.mPoolStrings;
+	scriber.mDedup = options.mDedup;
+	scriber.mPool = (options.mParallel && !options.mSharedPool ? options.mPool : 0);
+
+	if (!scriber.Build()) {
+		return 0;
+	}
+
+	/* The resource lives in the schema, copy it out before the next job reuses it. */
+	if (!scriber.ExportChunk(bin)) {
+		return 0;
+	}
+
+	scriber.ReleaseSchema();
+
+	if (symbols)
+	{
+		symbols->clear();
+		symbols->reserve(scriber.mSymbols.size());
+
+		for (auto& sym : scriber.mSymbols) {
+			symbols->push_back({ sym.mUID, sym.mStr });
+		}
+	}
+
+	return 1;
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Layout descriptors of the TrueCrowdDataBase versions.
+///
+///		TrueCrowdDefinition is declared with the SDHD layout. TW has room for 32 components,
+///		which moves the entity block (mEntityCount, mEntities) by 0xFC bytes and the tag block
+///		(mNumTags, mTagList) as well as the component entries of TrueCrowdDataBase by 0x2450
+///		bytes. Every other struct is shared, so only these blocks are accessed through the
+///		descriptor, the returned struct is only valid for the members of that block.
+///
+///		The version is detected by validating the structure against each layout (counts
+///		within the fixed arrays, null terminated component names, and every array, texture
+///		set and string down to the colour tints and override params inside the resource). A TW resource with up to 25 components also reads as an (empty) SDHD one,
+///		its unused component names land on the SDHD entity block. Such ties go to the layout
+///		that has an entry for every component, then to SDHD.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum ETCDatabaseVersion
+{
+	TCDB_VERSION_SDHD,
+	TCDB_VERSION_TW,
+	TCDB_VERSION_UNKNOWN
+};
+
+struct TCLayoutSDHD
+{
+	static constexpr ETCDatabaseVersion Version = TCDB_VERSION_SDHD;
+	static constexpr u32 MaxComponents = sizeof(TrueCrowdDefinition::mComponents) / sizeof(TrueCrowdDefinition::Component);
+	static constexpr uptr EntitiesOffset = 0;
+	static constexpr uptr TagsOffset = 0;
+	static constexpr uptr ComponentEntriesOffset = 0;
+};
+
+struct TCLayoutTW
+{
+	static constexpr ETCDatabaseVersion Version = TCDB_VERSION_TW;
+	static constexpr u32 MaxComponents = TCLayoutSDHD::MaxComponents + 0xFC / sizeof(TrueCrowdDefinition::Component);
+	static constexpr uptr EntitiesOffset = 0xFC;
+	static constexpr uptr TagsOffset = 0x2450;
+	static constexpr uptr ComponentEntriesOffset = 0x2450;
+};
+
+template <typename Layout>
+class TCDatabaseLayout
+{
+public:
+	static constexpr u32 MaxComponents = Layout::MaxComponents;
+	static constexpr u32 MaxEntities = sizeof(TrueCrowdDefinition::mEntities) / sizeof(TrueCrowdDefinition::Entity);
+	static constexpr u32 MaxEntityComponents = sizeof(TrueCrowdDefinition::Entity::mComponents) / sizeof(TrueCrowdDefinition::Entity::EntityComponent);
+	static constexpr u32 MaxBoneUIDs = sizeof(TrueCrowdDefinition::Entity::EntityComponent::mBoneUID) / sizeof(qSymbol);
+	static constexpr u32 MaxTags = 128;
+
+	/* Byte size of the TrueCrowdDataBase header. */
+	static constexpr size_t Size = sizeof(TrueCrowdDataBase) + Layout::ComponentEntriesOffset;
+
+	template <typename T>
+	static T* Offset(void* base, uptr offset) { return reinterpret_cast<T*>(reinterpret_cast<u8*>(base) + offset); }
+
+	static TrueCrowdDefinition::Component* GetComponents(TrueCrowdDataBase* db) { return db->mDefinition.mComponents; }
+
+	/* mEntityCount and mEntities only. */
+	static TrueCrowdDefinition* GetEntityBlock(TrueCrowdDataBase* db) { return Offset<TrueCrowdDefinition>(&db->mDefinition, Layout::EntitiesOffset); }
+
+	/* mNumTags and mTagList only. */
+	static TrueCrowdDefinition* GetTagBlock(TrueCrowdDataBase* db) { return Offset<TrueCrowdDefinition>(&db->mDefinition, Layout::TagsOffset); }
+
+	/* mNumComponentEntries and mComponentEntries only. */
+	static TrueCrowdDataBase* GetComponentEntryBlock(TrueCrowdDataBase* db) { return Offset<TrueCrowdDataBase>(db, Layout::ComponentEntriesOffset); }
+
+	//------------------------------------
+	//	Validation
+	//------------------------------------
+
+	/* size is the number of bytes readable from db, 0 if unknown skips the range checks. */
+	static bool InRange(TrueCrowdDataBase* db, u64 size, const void* data, u64 dataSize)
+	{
+		if (!size) {
+			return 1;
+		}
+
+		auto begin = reinterpret_cast<const u8*>(db);
+		auto ptr = static_cast<const u8*>(data);
+		return ptr >= begin && size >= dataSize && static_cast<u64>(ptr - begin) <= size - dataSize;
+	}
+
+	/* count elements at data, an empty array may have any offset. */
+	template <typename T>
+	static bool IsValidArray(TrueCrowdDataBase* db, u64 size, const T* data, u32 count)
+	{
+		return !count || (data && InRange(db, size, data, static_cast<u64>(count) * sizeof(T)));
+	}
+
+	/* Null terminated before the end of the readable bytes. */
+	static bool IsValidString(TrueCrowdDataBase* db, u64 size, const char* str)
+	{
+		if (!str) {
+			return 0;
+		}
+
+		if (!size) {
+			return 1;
+		}
+
+		if (!InRange(db, size, str, 1)) {
+			return 0;
+		}
+
+		const u64 remaining = size - static_cast<u64>(reinterpret_cast<const u8*>(str) - reinterpret_cast<const u8*>(db));
+		return memchr(str, 0, static_cast<size_t>(remaining)) != 0;
+	}
+
+	/* Name and the name of the high resolution resource, which is only read through its TrueCrowdResource base. */
+	static bool ValidateResource(TrueCrowdDataBase* db, u64 size, const TrueCrowdResource* resource)
+	{
+		if (!IsValidString(db, size, resource->mName.Get())) {
+			return 0;
+		}
+
+		auto highResResource = resource->mHighResolutionResource.Get();
+		return !highResResource || (InRange(db, size, highResResource, sizeof(TrueCrowdResource)) && IsValidString(db, size, highResResource->mName.Get()));
+	}
+
+	static bool ValidateModel(TrueCrowdDataBase* db, u64 size, const TrueCrowdModel* model)
+	{
+		if (!ValidateResource(db, size, model)) {
+			return 0;
+		}
+
+		auto lods = model->mLODModel.Get();
+		if (!IsValidArray(db, size, lods, model->mNumLODs)) {
+			return 0;
+		}
+
+		for (u32 i = 0; model->mNumLODs > i; ++i)
+		{
+			auto modelParts = lods[i].mModelParts.Get();
+			if (!IsValidArray(db, size, modelParts, lods[i].mNumModelParts)) {
+				return 0;
+			}
+
+			for (u32 j = 0; lods[i].mNumModelParts > j; ++j)
+			{
+				if (!IsValidString(db, size, modelParts[j].mModelName.Get())) {
+					return 0;
+				}
+			}
+		}
+
+		auto textureSets = model->mTextureSets.Get();
+		if (!IsValidArray(db, size, textureSets, model->mNumTextureSets)) {
+			return 0;
+		}
+
+		/* Shared texture sets of content dedup are checked once per reference. */
+		for (u32 i = 0; model->mNumTextureSets > i; ++i)
+		{
+			auto textureSet = textureSets[i].Get();
+			if (!textureSet || !InRange(db, size, textureSet, sizeof(TrueCrowdTextureSet)) || !ValidateResource(db, size, textureSet)) {
+				return 0;
+			}
+
+			if (!IsValidArray(db, size, textureSet->mColourTints.Get(), textureSet->mNumColorTints) || !IsValidArray(db, size, textureSet->mTextureOverrideParams.Get(), textureSet->mNumTextureOverrideParams)) {
+				return 0;
+			}
+		}
+
+		return 1;
+	}
+
+	static bool Validate(TrueCrowdDataBase* db, u64 size)
+	{
+		if (size && Size > size) {
+			return 0;
+		}
+
+		auto definition = &db->mDefinition;
+		if (definition->mComponentCount > MaxComponents) {
+			return 0;
+		}
+
+		auto components = GetComponents(db);
+		for (u32 i = 0; definition->mComponentCount > i; ++i)
+		{
+			if (!memchr(components[i].mName, 0, sizeof(components[i].mName))) {
+				return 0;
+			}
+		}
+
+		auto entityBlock = GetEntityBlock(db);
+		if (entityBlock->mEntityCount > MaxEntities) {
+			return 0;
+		}
+
+		for (u32 i = 0; entityBlock->mEntityCount > i; ++i)
+		{
+			auto& entity = entityBlock->mEntities[i];
+			if (entity.mComponentCount > MaxEntityComponents || entity.mRequiredComponentCount > entity.mComponentCount) {
+				return 0;
+			}
+
+			for (u32 j = 0; entity.mComponentCount > j; ++j)
+			{
+				if (entity.mComponents[j].mNumBoneUIDs > MaxBoneUIDs) {
+					return 0;
+				}
+			}
+		}
+
+		auto tagBlock = GetTagBlock(db);
+		if (tagBlock->mNumTags > MaxTags || (tagBlock->mNumTags && !InRange(db, size, tagBlock->mTagList.Get(), tagBlock->mNumTags * sizeof(qSymbol)))) {
+			return 0;
+		}
+
+		auto componentEntryBlock = GetComponentEntryBlock(db);
+		if (componentEntryBlock->mNumComponentEntries > definition->mComponentCount) {
+			return 0;
+		}
+
+		if (!componentEntryBlock->mNumComponentEntries) {
+			return 1;
+		}
+
+		auto componentEntries = componentEntryBlock->mComponentEntries.Get();
+		if (!componentEntries || !InRange(db, size, componentEntries, componentEntryBlock->mNumComponentEntries * sizeof(TrueCrowdDataBase::ComponentEntries))) {
+			return 0;
+		}
+
+		for (u32 i = 0; componentEntryBlock->mNumComponentEntries > i; ++i)
+		{
+			auto& entry = componentEntries[i];
+			auto entries = entry.mEntries.Get();
+			if (!IsValidArray(db, size, entries, entry.mNumEntries)) {
+				return 0;
+			}
+
+			for (u32 j = 0; entry.mNumEntries > j; ++j)
+			{
+				if (!ValidateModel(db, size, &entries[j].mResource)) {
+					return 0;
+				}
+			}
+		}
+
+		return 1;
+	}
+
+	/* Every component has its entry, holds for everything the scriber writes. */
+	static bool HasAllComponentEntries(TrueCrowdDataBase* db) { return GetComponentEntryBlock(db)->mNumComponentEntries == db->mDefinition.mComponentCount; }
+};
+
+class TCDatabaseLayouts
+{
+public:
+	static const char* GetName(ETCDatabaseVersion version)
+	{
+		switch (version)
+		{
+		case TCDB_VERSION_SDHD:
+			return "SDHD";
+		case TCDB_VERSION_TW:
+			return "TW";
+		default:
+			return "Unknown";
+		}
+	}
+
+	/* size is the number of bytes readable from db, the TW blocks lie past the end of a small SDHD resource. */
+	static ETCDatabaseVersion Detect(TrueCrowdDataBase* db, u64 size)
+	{
+		const bool isSDHD = TCDatabaseLayout<TCLayoutSDHD>::Validate(db, size);
+		const bool isTW = TCDatabaseLayout<TCLayoutTW>::Validate(db, size);
+
+		if (isSDHD && isTW && !TCDatabaseLayout<TCLayoutSDHD>::HasAllComponentEntries(db) && TCDatabaseLayout<TCLayoutTW>::HasAllComponentEntries(db)) {
+			return TCDB_VERSION_TW;
+		}
+
+		return (isSDHD ? TCDB_VERSION_SDHD : isTW ? TCDB_VERSION_TW : TCDB_VERSION_UNKNOWN);
+	}
+};
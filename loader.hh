@@ -0,0 +1,149 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include "platform.hh"
+#include "layout.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Loads a TrueCrowdDataBase chunk for reading.
+///
+///		The file is mapped read-only and the converter reads the resource in place, qOffset64
+///		pointers are relative so nothing has to be copied or fixed up. If the mapping fails the
+///		whole file is read into heap memory instead. A chunk already in memory is read where it
+///		is, and - reads the chunk from stdin. The layout version is detected once here, a
+///		resource that is valid in neither layout is rejected.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCDatabaseLoader
+{
+public:
+	FileMapping mMapping;
+	void* mHeapData = 0;
+
+	/* Aligned copy of a misaligned memory chunk, or the chunk read from a stream. */
+	std::vector<u64> mCopy;
+
+	qChunk* mChunk = 0;
+	TrueCrowdDataBase* mDB = 0;
+	ETCDatabaseVersion mVersion = TCDB_VERSION_UNKNOWN;
+
+	~TCDatabaseLoader()
+	{
+		if (mHeapData) {
+			qFree(mHeapData);
+		}
+	}
+
+	bool IsMapped() const { return mMapping.mData != 0; }
+
+	bool Load(const char* filename, bool allowMapping = 1)
+	{
+		if (IsStdStream(filename)) {
+			return LoadStream(stdin, "<stdin>");
+		}
+
+		u64 fileSize = 0;
+
+		if (allowMapping && mMapping.Open(filename))
+		{
+			mChunk = static_cast<qChunk*>(mMapping.mData);
+			fileSize = mMapping.mSize;
+		}
+		else
+		{
+			mHeapData = StreamFileWrapper::ReadEntireFile(filename);
+			mChunk = static_cast<qChunk*>(mHeapData);
+
+			std::error_code ec;
+			fileSize = static_cast<u64>(std::filesystem::file_size(filename, ec));
+			if (ec) {
+				fileSize = 0;
+			}
+		}
+
+		if (!mChunk)
+		{
+			qPrintf("ERROR: Failed to read %s.\n", filename);
+			return 0;
+		}
+
+		return Validate(filename, fileSize);
+	}
+
+	/* Reads a chunk that is already in memory. data is used in place when it is u64 aligned and must outlive the loader, otherwise it is copied. */
+	bool Load(const void* data, u64 size, const char* name)
+	{
+		if (reinterpret_cast<uptr>(data) % alignof(u64))
+		{
+			mCopy.resize(static_cast<size_t>((size + sizeof(u64) - 1) / sizeof(u64)));
+			qMemCopy(mCopy.data(), data, static_cast<size_t>(size));
+			data = mCopy.data();
+		}
+
+		mChunk = static_cast<qChunk*>(const_cast<void*>(data));
+		return Validate(name, size);
+	}
+
+	/* Reads a stream that can't be mapped or sized up front (a pipe) block by block. */
+	bool LoadStream(FILE* stream, const char* name)
+	{
+		static constexpr size_t BlockSize = 0x10000;
+
+		SetBinaryMode(stream);
+
+		size_t size = 0;
+		for (;;)
+		{
+			if (BlockSize > mCopy.size() * sizeof(u64) - size) {
+				mCopy.resize((mCopy.size() ? mCopy.size() * 2 : BlockSize / sizeof(u64)));
+			}
+
+			const size_t numRead = fread(reinterpret_cast<u8*>(mCopy.data()) + size, 1, mCopy.size() * sizeof(u64) - size, stream);
+			if (!numRead) {
+				break;
+			}
+
+			size += numRead;
+		}
+
+		if (ferror(stream))
+		{
+			qPrintf("ERROR: Failed to read %s.\n", name);
+			return 0;
+		}
+
+		mChunk = reinterpret_cast<qChunk*>(mCopy.data());
+		return Validate(name, size);
+	}
+
+	bool Validate(const char* filename, u64 fileSize)
+	{
+		if (sizeof(qChunk) > fileSize)
+		{
+			qPrintf("ERROR: The input file is too small to be a TrueCrowdDataBase resource.\n");
+			return 0;
+		}
+
+		mDB = static_cast<TrueCrowdDataBase*>(mChunk->GetData());
+
+		const u64 offset = static_cast<u64>(reinterpret_cast<u8*>(mDB) - reinterpret_cast<u8*>(mChunk));
+		if (offset + sizeof(TrueCrowdDataBase) > fileSize || mChunk->mUID != ChunkUID_TrueCrowdDataBase || mDB->mTypeUID != RTypeUID_TrueCrowdDataBase)
+		{
+			qPrintf("ERROR: The input file is not a TrueCrowdDataBase resource.\n");
+			return 0;
+		}
+
+		mVersion = TCDatabaseLayouts::Detect(mDB, fileSize - offset);
+		if (mVersion == TCDB_VERSION_UNKNOWN)
+		{
+			qPrintf("ERROR: The TrueCrowdDataBase in %s matches neither the SDHD nor the TW layout.\n", filename);
+			return 0;
+		}
+
+		return 1;
+	}
+};
@@ -3,37 +3,32 @@
 #define THEORY_QSYMBOL_TABLE_INVENTORY
 #include "theory/theory.hh"
 
-#define XTag_TCDB						"TrueCrowdDataBase"
-#define XTag_Definition					"Definition"
-#define XTag_Entity						"Entity"
-#define XTag_EntityComponent			"EntityComponent"
-#define XTag_BoneUID					"BoneUID"
-#define XTag_Tags						"Tags"
-#define XTag_Tag						"Tag"
-#define XTag_ComponentEntries			"ComponentEntries"
-#define XTag_Component					"Component"
-#define XTag_Resource					"Resource"
-#define XTag_HighResolutionResource		"HighResolutionResource"
-#define XTag_LOD						"LOD"
-#define XTag_ModelPart					"ModelPart"
-#define XTag_TextureSet					"TextureSet"
-#define XTag_ColourTint					"ColourTint"
-#define XTag_OverrideParam				"OverrideParam"
-
-#define XAttr_Name						"name"
-#define XAttr_NameUID					"nameUID"
-#define XAttr_ResourceIndex				"resourceIndex"
-#define XAttr_Required					"required"
-#define XAttr_Type						"type"
-#define XAttr_IsSkinned					"isSkinned"
-#define XAttr_MorphType					"morphType"
-#define XAttr_Sampler					"sampler"
-#define XAttr_UID0						"uid0"
-#define XAttr_UID1						"uid1"
-#define XAttr_UID2						"uid2"
-
-#include "converter.hh"
-#include "scriber.hh"
+#include "tcdb.hh"
+#include "batch.hh"
+#include "bench.hh"
+#include "query.hh"
+#include "serve.hh"
+
+/* Replacements of the global operators for GetNumHeapAllocations, defined once here rather than in platform.hh. */
+#ifdef TCDB_COUNT_ALLOCATIONS
+	#include <cstdlib>
+	#include <new>
+
+	void* operator new(size_t size)
+	{
+		++GetHeapAllocationCounter();
+
+		if (void* ptr = malloc(size ? size : 1)) {
+			return ptr;
+		}
+
+		throw std::bad_alloc();
+	}
+
+	void operator delete(void* ptr) noexcept { free(ptr); }
+
+	void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 ///		
@@ -109,62 +104,339 @@ int main(int argc, char** argv)
 		return "";
 	};
 
+	auto GetArgs = [&argc, &argv](const char* arg) -> std::vector<const char*>
+	{
+		std::vector<const char*> values;
+		for (int i = 0; argc - 1 > i; ++i)
+		{
+			if (!UFG::qStringCompareInsensitive(argv[i], arg)) {
+				values.push_back(argv[++i]);
+			}
+		}
+
+		return values;
+	};
+
 	qInit();
 
 	const bool convert = !GetArg("-conv", 1).IsEmpty();
 	const bool scribe = !GetArg("-scribe", 1).IsEmpty();
-	auto qsymbols = GetArg("-qsymbols");
+	const bool verify = !GetArg("-verify", 1).IsEmpty();
+	const bool streaming = !GetArg("-stream", 1).IsEmpty();
+	const bool noMapping = !GetArg("-nommap", 1).IsEmpty();
+	const bool parallel = !GetArg("-parallel", 1).IsEmpty();
+	const bool incremental = !GetArg("-incremental", 1).IsEmpty();
+	const bool verbose = !GetArg("-verbose", 1).IsEmpty();
+	const bool stats = !GetArg("-stats", 1).IsEmpty();
+	const bool compact = !GetArg("-compact", 1).IsEmpty();
+	const bool asyncWrite = !GetArg("-asyncwrite", 1).IsEmpty();
+	const bool tw = !GetArg("-tw", 1).IsEmpty();
+	const bool poolStrings = !GetArg("-poolstrings", 1).IsEmpty();
+	const bool dedup = !GetArg("-dedup", 1).IsEmpty();
+	auto qsymbols = GetArgs("-qsymbols");
+	auto compileQSymbols = GetArg("-compile-qsymbols");
 	auto filename = GetArg("-file");
+	auto output = GetArg("-out");
+	auto batch = GetArg("-batch");
+	auto jobs = GetArg("-jobs");
+	auto gen = GetArg("-gen");
+	auto bench = GetArg("-bench");
+	auto query = GetArg("-query");
+	auto writeBuffer = GetArg("-writebuffer");
+	auto serve = GetArg("-serve");
+	auto client = GetArg("-client");
+
+	const u32 numJobs = (jobs.IsEmpty() ? 0 : static_cast<u32>(strtoul(jobs, 0, 10)));
+
+	/* Symbol Dictionary */
+
+	if (!compileQSymbols.IsEmpty())
+	{
+		if (qsymbols.empty())
+		{
+			qPrintf("ERROR: -compile-qsymbols requires at least one -qsymbols <filename> source.\n");
+			return 1;
+		}
+
+		TCSymbolCompiler compiler;
+		for (auto source : qsymbols)
+		{
+			if (!compiler.AddTextFile(source)) {
+				return 1;
+			}
+		}
+
+		TCSymbolDictionary dictionary;
+		compiler.Build(dictionary);
+		return (dictionary.Write(compileQSymbols) ? 0 : 1);
+	}
+
+	/* Generator */
+
+	TCGeneratorOptions genOptions;
+	if (!gen.IsEmpty() && !genOptions.Parse(gen)) {
+		return 1;
+	}
+
+	if (!bench.IsEmpty())
+	{
+		std::unique_ptr<ThreadPool> pool;
+		if (parallel) {
+			pool.reset(new ThreadPool(numJobs));
+		}
+
+		TCBenchmark benchmark;
+		benchmark.mPool = pool.get();
+		return (benchmark.Run(bench, genOptions, filename) ? 0 : 1);
+	}
+
+	if (!gen.IsEmpty())
+	{
+		if (filename.IsEmpty())
+		{
+			qPrintf("ERROR: -gen requires -file <filename> for the generated XML.\n");
+			return 1;
+		}
+
+		TCDatabaseGenerator generator = { genOptions };
+		if (!generator.Generate(filename)) {
+			return 1;
+		}
+
+		qPrintf("Generated %llu nodes to: %s\n", generator.mXMLW.mNumNodes, filename.mData);
+		return 0;
+	}
+
+	/* Client */
+
+	if (!client.IsEmpty())
+	{
+		std::vector<std::string> clientJobs;
+		if (!filename.IsEmpty())
+		{
+			/* The server resolves paths against its own working directory. */
+			std::string job = (convert ? "conv " : scribe ? "scribe " : verify ? "verify " : "query ");
+			job += std::filesystem::absolute(filename.mData).string();
+
+			if (!query.IsEmpty())
+			{
+				job += ' ';
+				job += query.mData;
+			}
+
+			clientJobs.push_back(job);
+		}
+		else
+		{
+			for (std::string line; std::getline(std::cin, line);) {
+				clientJobs.push_back(line);
+			}
+		}
 
-	if (!convert && !scribe || filename.IsEmpty())
+		return (TCClient::Run(client, clientJobs) ? 0 : 1);
+	}
+
+	if (serve.IsEmpty() && (!convert && !scribe && !verify && query.IsEmpty() || filename.IsEmpty() && batch.IsEmpty()))
 	{
 		qPrintf("ERROR: Missing parameters.\n\n");
 		qPrintf("Usage: %s [options]\n", argv[0]);
 		qPrintf("\nOptions:\n");
 		qPrintf("  %-25s %s\n", "-conv", "Convert TrueCrowdDataBase to XML.");
 		qPrintf("  %-25s %s\n", "-scribe", "Scribe TrueCrowdDataBase in XML to binary file.");
-		qPrintf("  %-25s %s\n", "-qsymbols <filename>", "QSymbol Table Resource to load.");
-		qPrintf("  %-25s %s\n", "-file <filename>", "Specify the file for processing.");
+		qPrintf("  %-25s %s\n", "-verify", "Round trip TrueCrowdDataBase through the -conv XML writer and both the default and");
+		qPrintf("  %-25s %s\n", "", "-stream scribe parser, and compare the results with the input.");
+		qPrintf("  %-25s %s\n", "", "With -parallel or -asyncwrite, also check that those conversions write the same bytes.");
+		qPrintf("  %-25s %s\n", "-query <query|->", "Answer \"tag|name|sampler|component <value>\" queries over binary -file,");
+		qPrintf("  %-25s %s\n", "", "separated by ';'. Use - to read queries line by line from stdin.");
+		qPrintf("  %-25s %s\n", "-stream", "Scribe in a single streaming pass without loading the whole XML document.");
+		qPrintf("  %-25s %s\n", "", "Uses tcdb's own XML parser, SimpleXML stays the default.");
+		qPrintf("  %-25s %s\n", "-nommap", "Read the input into memory instead of mapping it when converting.");
+		qPrintf("  %-25s %s\n", "-parallel", "Convert or scribe components on worker threads and merge them in order.");
+		qPrintf("  %-25s %s\n", "-incremental", "Scribe only components that changed since the last -incremental run (implies -stream).");
+		qPrintf("  %-25s %s\n", "-tw", "Scribe the TW layout (up to 32 components) instead of SDHD.");
+		qPrintf("  %-25s %s\n", "-poolstrings", "Store identical names once in the scribed StringBuffer (ignored with -incremental).");
+		qPrintf("  %-25s %s\n", "-dedup", "Store identical texture sets, colour tint and override param arrays once (ignored with -incremental).");
+		qPrintf("  %-25s %s\n", "-compact", "Write converted XML without indentation. Formatted by tcdb's own writer, not the engine's.");
+		qPrintf("  %-25s %s\n", "-asyncwrite", "Write converted XML on a background thread while the next nodes are recorded.");
+		qPrintf("  %-25s %s\n", "-writebuffer <KiB>", "Size of the converted XML output buffer (default: 32).");
+		qPrintf("  %-25s %s\n", "-verbose", "Print additional statistics.");
+		qPrintf("  %-25s %s\n", "-stats", "Write phase timings and counters as JSON next to the output (<output>.stats.json).");
+		qPrintf("  %-25s %s\n", "-qsymbols <filename>", "QSymbol Table Resource, compiled dictionary or 0xUID name text file to load,");
+		qPrintf("  %-25s %s\n", "", "can be repeated. Text files are merged, the first name of a UID wins.");
+		qPrintf("  %-25s %s\n", "-compile-qsymbols <file>", "Compile the -qsymbols text sources (0xUID name lines) into a dictionary.");
+		qPrintf("  %-25s %s\n", "-file <filename|->", "Specify the file for processing, - reads it from stdin (output then goes to stdout).");
+		qPrintf("  %-25s %s\n", "-out <filename|->", "Output file of -conv/-scribe instead of one next to -file, - writes to stdout.");
+		qPrintf("  %-25s %s\n", "-batch <list|glob|dir>", "Process every file from a list file, glob pattern or directory.");
+		qPrintf("  %-25s %s\n", "-jobs <count>", "Number of worker threads for -batch (default: all cores).");
+		qPrintf("  %-25s %s\n", "-gen <key=value,...>", "Generate a synthetic XML to -file. Keys: components, resources, lods, parts,");
+		qPrintf("  %-25s %s\n", "", "texturesets, tints, params, tags, resourcetags, entities, seed.");
+		qPrintf("  %-25s %s\n", "-serve <socket|->", "Stay resident and run conv/scribe/verify/query <file> job lines from a Unix socket");
+		qPrintf("  %-25s %s\n", "", "or stdin (-), on -jobs threads with the symbols loaded once. Options apply to all jobs.");
+		qPrintf("  %-25s %s\n", "-client <socket>", "Send a job built from -conv/-scribe/-verify/-query and -file, or job lines from");
+		qPrintf("  %-25s %s\n", "", "stdin, to a -serve socket and print the answers.");
+		qPrintf("  %-25s %s\n", "-bench <scales>", "Benchmark generate/scribe/conv for each number of resources per component,");
+		qPrintf("  %-25s %s\n", "", "e.g. 10,100,1000. Uses -gen as base options and -file as work directory.");
 		return 1;
 	}
 
-	/* Converter */
+	/* Pipes */
+
+	const bool stdinInput = IsStdStream(filename);
+	const bool stdoutOutput = (convert || scribe) && (output.IsEmpty() ? stdinInput : IsStdStream(output));
 
-	if (convert)
+	if (!output.IsEmpty() && (!batch.IsEmpty() || !serve.IsEmpty()))
 	{
-		if (qsymbols.IsEmpty() || !StreamResourceLoader::LoadResourceFile(qsymbols)) {
+		qPrintf("ERROR: -out can't be used with -batch or -serve, outputs are written next to each input.\n");
+		return 1;
+	}
+
+	if (stdoutOutput && !DetachStdout())
+	{
+		qPrintf("ERROR: Failed to redirect messages away from stdout.\n");
+		return 1;
+	}
+
+	TCJobOptions options;
+	options.mOutput = (output.IsEmpty() ? 0 : output.mData);
+	options.mStreaming = streaming;
+	options.mNoMapping = noMapping;
+	options.mParallel = parallel;
+	options.mIncremental = incremental;
+	options.mVerbose = verbose;
+	options.mStats = stats;
+	options.mCompact = compact;
+	options.mAsyncWrite = asyncWrite;
+	options.mScribeVersion = (tw ? TCDB_VERSION_TW : TCDB_VERSION_SDHD);
+	options.mPoolStrings = poolStrings;
+	options.mDedup = dedup;
+
+	if (incremental && stdinInput && scribe)
+	{
+		qPrintf("WARN: -incremental is ignored when reading from stdin, there is no file to keep the cache next to.\n");
+		options.mIncremental = 0;
+	}
+
+	if (stats && stdoutOutput)
+	{
+		qPrintf("WARN: -stats is ignored when writing to stdout, there is no file to put the JSON next to.\n");
+		options.mStats = 0;
+	}
+
+	if (poolStrings && options.mIncremental && scribe) {
+		qPrintf("WARN: -poolstrings is ignored with -incremental, cached components keep their own strings.\n");
+	}
+
+	if (dedup && options.mIncremental && scribe) {
+		qPrintf("WARN: -dedup is ignored with -incremental, cached components keep their own arrays.\n");
+	}
+
+	if (!writeBuffer.IsEmpty())
+	{
+		const u32 writeBufferSize = static_cast<u32>(strtoul(writeBuffer, 0, 10));
+		if (!writeBufferSize)
+		{
+			qPrintf("ERROR: Invalid -writebuffer size %s.\n", writeBuffer.mData);
+			return 1;
+		}
+
+		options.mWriteBufferSize = static_cast<size_t>(writeBufferSize) * 1024;
+	}
+
+	/* QSymbols */
+
+	if (convert || verify || !query.IsEmpty() || !serve.IsEmpty())
+	{
+		auto start = TCStats::Clock::now();
+
+		TCSymbolLoader symbolLoader;
+		if (qsymbols.empty() || !symbolLoader.Load(qsymbols)) {
 			qPrintf("WARN: QSymbols dictionary was not specified or failed to load. Symbols will be shown as hexadecimal strings.\n");
 		}
 
-		auto trueCrowdChunk = reinterpret_cast<qChunk*>(StreamFileWrapper::ReadEntireFile(filename));
-		auto trueCrowdDB = static_cast<TrueCrowdDataBase*>(trueCrowdChunk->GetData());
-		if (trueCrowdChunk->mUID != ChunkUID_TrueCrowdDataBase || trueCrowdDB->mTypeUID != RTypeUID_TrueCrowdDataBase)
+		options.mSymbolTableLoadTime = TCStats::ToMilliseconds(TCStats::Clock::now() - start);
+
+		if (verbose && symbolLoader.mNumTextSources) {
+			qPrintf("Merged %u symbol(s) from %u text file(s) in %.3f ms.\n", symbolLoader.mNumTextSymbols, symbolLoader.mNumTextSources, options.mSymbolTableLoadTime);
+		}
+	}
+
+	/* Server */
+
+	if (!serve.IsEmpty())
+	{
+		ThreadPool pool(numJobs);
+		options.mPool = &pool;
+		options.mSharedPool = 1;
+
+		TCServer server = { options };
+		return (server.Run(serve) ? 0 : 1);
+	}
+
+	/* Query */
+
+	if (!query.IsEmpty())
+	{
+		if (filename.IsEmpty())
 		{
-			qPrintf("ERROR: The input file is not a TrueCrowdDataBase resource.\n");
+			qPrintf("ERROR: -query requires -file <filename> of a binary database.\n");
+			return 1;
+		}
+
+		TCDatabaseLoader loader;
+		if (!loader.Load(filename, !noMapping)) {
 			return 1;
 		}
 
-		auto xmlFilename = filename.GetFilePathWithoutExtension() + ".xml";
-		TCDatabaseConverter converter = { trueCrowdDB, xmlFilename };
-		converter.Export();
+		auto start = TCStats::Clock::now();
+		TCDatabaseQuery tcQuery = { loader.mDB, loader.mVersion };
 
-		qPrintf("File has been exported to: %s\n", xmlFilename.mData);
-		return 0;
+		if (verbose) {
+			qPrintf("Indexed %u resource(s) and %u texture set(s) in %.3f ms.\n", static_cast<u32>(tcQuery.mResources.size()), static_cast<u32>(tcQuery.mTextureSets.size()), TCStats::ToMilliseconds(TCStats::Clock::now() - start));
+		}
+
+		return ((strcmp(query, "-") ? tcQuery.RunLine(query) : tcQuery.RunStream(std::cin)) ? 0 : 1);
 	}
 
-	/* Scriber */
+	/* Batch */
 
-	TCDatabaseScriber scriber = { filename };
-	if (!scriber.mXML) {
-		return 1;
+	if (!batch.IsEmpty())
+	{
+		TCBatch tcBatch;
+		if (!tcBatch.Collect(batch, (convert || verify ? ".bin" : ".xml"))) {
+			return 1;
+		}
+
+		return (tcBatch.Run((convert ? ConvertFile : verify ? VerifyFile : ScribeFile), options, numJobs) ? 1 : 0);
+	}
+
+	std::unique_ptr<ThreadPool> pool;
+	if (parallel && (convert || scribe || verify))
+	{
+		pool.reset(new ThreadPool(numJobs));
+		options.mPool = pool.get();
+	}
+
+	/* Converter */
+
+	if (convert) {
+		return (ConvertFile(filename, options) ? 0 : 1);
+	}
+
+	/* Verify */
+
+	if (verify) {
+		return (VerifyFile(filename, options) ? 0 : 1);
 	}
 
-	if (!scriber.Build()) {
+	/* Scriber */
+
+	if (!ScribeFile(filename, options)) {
 		return 1;
 	}
 
-	auto binFilename = filename.GetFilePathWithoutExtension() + ".bin";
-	scriber.Export(binFilename);
+	if (streaming || incremental) {
+		qPrintf("Peak memory usage: %.2f MiB\n", BytesToMiB(GetPeakMemoryUsage()));
+	}
 	
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,309 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <Windows.h>
+	#include <Psapi.h>
+	#include <fcntl.h>
+	#include <io.h>
+	#pragma comment(lib, "Psapi.lib")
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/resource.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace UFG;
+
+//------------------------------------
+//	Process
+//------------------------------------
+
+/* Peak resident set size of the process in bytes. */
+inline u64 GetPeakMemoryUsage()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return static_cast<u64>(counters.PeakWorkingSetSize);
+	}
+
+	return 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return 0;
+	}
+
+	#ifdef __APPLE__
+		return static_cast<u64>(usage.ru_maxrss);
+	#else
+		return static_cast<u64>(usage.ru_maxrss) * 1024;
+	#endif
+#endif
+}
+
+inline double BytesToMiB(u64 bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+//------------------------------------
+//	Temporary Files
+//------------------------------------
+
+/* Path in the temporary directory that is unique to this process and call, the file is not created. */
+inline std::string GetTempFilename(const char* extension)
+{
+	static std::atomic<u32> counter = { 0 };
+
+#ifdef _WIN32
+	const u32 processID = static_cast<u32>(GetCurrentProcessId());
+#else
+	const u32 processID = static_cast<u32>(getpid());
+#endif
+
+	std::error_code ec;
+	auto directory = std::filesystem::temp_directory_path(ec);
+	auto name = "tcdb_" + std::to_string(processID) + "_" + std::to_string(counter++) + extension;
+	return (ec ? std::filesystem::path(name) : directory / name).string();
+}
+
+/* Byte for byte comparison, a file that can't be read compares unequal. */
+inline bool FilesEqual(const char* filename0, const char* filename1)
+{
+	std::ifstream file0(filename0, std::ios::binary);
+	std::ifstream file1(filename1, std::ios::binary);
+	if (!file0 || !file1) {
+		return 0;
+	}
+
+	return std::equal(std::istreambuf_iterator<char>(file0), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(file1), std::istreambuf_iterator<char>());
+}
+
+/* Copies a file written by an engine API that only takes filenames to stream. */
+inline bool CopyFileToStream(const char* filename, FILE* stream)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file) {
+		return 0;
+	}
+
+	char buf[0x10000];
+	bool result = 1;
+
+	for (size_t size; (size = fread(buf, 1, sizeof(buf), file)) != 0;)
+	{
+		if (fwrite(buf, 1, size, stream) != size)
+		{
+			result = 0;
+			break;
+		}
+	}
+
+	fclose(file);
+	fflush(stream);
+	return result;
+}
+
+template <typename T>
+inline bool ReadEntireFile(const char* filename, std::vector<T>& data)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return 1;
+}
+
+//------------------------------------
+//	Allocation Counter
+//------------------------------------
+
+/*
+*	Build with TCDB_COUNT_ALLOCATIONS defined to count calls to the global operator new,
+*	-verbose then reports the allocations made while exporting. Only C++ heap allocations
+*	are counted, memory taken through the engine allocator is not. The counter is process
+*	wide, so with batch jobs running it includes the other jobs too. The operators are
+*	replaced once in main.cc, a program embedding tcdb.hh has to replace them itself.
+*/
+#ifdef TCDB_COUNT_ALLOCATIONS
+	#include <atomic>
+
+	inline std::atomic<u64>& GetHeapAllocationCounter()
+	{
+		static std::atomic<u64> counter = { 0 };
+		return counter;
+	}
+
+	inline u64 GetNumHeapAllocations() { return GetHeapAllocationCounter().load(); }
+#else
+	inline u64 GetNumHeapAllocations() { return 0; }
+#endif
+
+//------------------------------------
+//	Standard Streams
+//------------------------------------
+
+/* "-" in place of a filename reads from stdin or writes to stdout. */
+inline bool IsStdStream(const char* filename) { return filename[0] == '-' && !filename[1]; }
+
+/* Stream that "-" outputs are written to, stdout unless DetachStdout moved it. */
+inline FILE*& GetOutputStream()
+{
+	static FILE* stream = stdout;
+	return stream;
+}
+
+inline void SetBinaryMode(FILE* stream)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stream), _O_BINARY);
+#else
+	(void)stream;
+#endif
+}
+
+/*
+*	Keeps the real stdout for the data written to "-" and sends everything printed to stderr
+*	from now on, so messages and warnings can't end up in the middle of a piped file.
+*/
+inline bool DetachStdout()
+{
+	fflush(stdout);
+
+#ifdef _WIN32
+	const int fd = _dup(_fileno(stdout));
+	FILE* stream = (fd < 0 ? 0 : _fdopen(fd, "wb"));
+	if (!stream || _dup2(_fileno(stderr), _fileno(stdout))) {
+		return 0;
+	}
+#else
+	const int fd = dup(STDOUT_FILENO);
+	FILE* stream = (fd < 0 ? 0 : fdopen(fd, "wb"));
+	if (!stream || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+		return 0;
+	}
+#endif
+
+	SetBinaryMode(stream);
+	GetOutputStream() = stream;
+	return 1;
+}
+
+//------------------------------------
+//	File Mapping
+//------------------------------------
+
+/* Read-only, private mapping of a whole file. */
+class FileMapping
+{
+public:
+	void* mData = 0;
+	u64 mSize = 0;
+
+#ifdef _WIN32
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = 0;
+#else
+	int mFD = -1;
+#endif
+
+	~FileMapping() { Close(); }
+
+	bool Open(const char* filename)
+	{
+		Close();
+
+#ifdef _WIN32
+		mFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		if (mFile == INVALID_HANDLE_VALUE) {
+			return 0;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(mFile, &size) || !size.QuadPart)
+		{
+			Close();
+			return 0;
+		}
+
+		mMapping = CreateFileMappingA(mFile, 0, PAGE_READONLY, 0, 0, 0);
+		if (!mMapping)
+		{
+			Close();
+			return 0;
+		}
+
+		mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+		mSize = static_cast<u64>(size.QuadPart);
+#else
+		mFD = open(filename, O_RDONLY);
+		if (mFD == -1) {
+			return 0;
+		}
+
+		struct stat st;
+		if (fstat(mFD, &st) || !st.st_size)
+		{
+			Close();
+			return 0;
+		}
+
+		void* data = mmap(0, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, mFD, 0);
+		mData = (data == MAP_FAILED ? 0 : data);
+		mSize = static_cast<u64>(st.st_size);
+#endif
+
+		if (!mData)
+		{
+			Close();
+			return 0;
+		}
+
+		return 1;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (mData) {
+			UnmapViewOfFile(mData);
+		}
+
+		if (mMapping) {
+			CloseHandle(mMapping);
+		}
+
+		if (mFile != INVALID_HANDLE_VALUE) {
+			CloseHandle(mFile);
+		}
+
+		mMapping = 0;
+		mFile = INVALID_HANDLE_VALUE;
+#else
+		if (mData) {
+			munmap(mData, static_cast<size_t>(mSize));
+		}
+
+		if (mFD != -1) {
+			close(mFD);
+		}
+
+		mFD = -1;
+#endif
+
+		mData = 0;
+		mSize = 0;
+	}
+};
@@ -0,0 +1,357 @@
+#pragma once
+#include <cstdarg>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Lookups over a loaded TrueCrowdDataBase without exporting it (-query).
+///
+///		The indexes are built in one pass over the database and reference it in place, names
+///		are views into its string buffer. Queries are "<kind> <value>", several can be given
+///		separated by ';' or read line by line from stdin:
+///
+///		- tag <tag>:				resources that carry the tag,
+///		- name <name>:				resources and texture sets with the name,
+///		- sampler <sampler>:		texture sets with an override param for the sampler,
+///		- component <component>:	entities that reference the component.
+///
+///		Symbol values are hashed like the scriber does, "0x..." or "~0x...~" is taken as UID.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCDatabaseQuery
+{
+public:
+	struct ResourceRef
+	{
+		u32 mComponent;
+		TrueCrowdModel* mModel;
+	};
+
+	struct TextureSetRef
+	{
+		u32 mResource;
+		TrueCrowdTextureSet* mTextureSet;
+	};
+
+	/* Used for the layout aware accessors and symbol strings. */
+	TCDatabaseConverter mConverter;
+
+	std::vector<ResourceRef> mResources;
+	std::vector<TextureSetRef> mTextureSets;
+
+	std::unordered_map<u32, u32> mTagBits;
+	std::vector<std::vector<u32>> mResourcesByTag;
+	std::unordered_map<std::string_view, std::vector<u32>> mResourcesByName;
+	std::unordered_map<std::string_view, std::vector<u32>> mTextureSetsByName;
+	std::unordered_map<u32, std::vector<u32>> mTextureSetsBySampler;
+	std::unordered_map<u32, std::vector<u32>> mEntitiesByComponent;
+
+	/* Results and errors are appended here instead of printed when set. */
+	std::string* mOutput = 0;
+
+	TCDatabaseQuery(TrueCrowdDataBase* db, ETCDatabaseVersion version) : mConverter(db, version, static_cast<XMLBufferWriter*>(0)) { Build(); }
+
+	//------------------------------------
+	//	Index
+	//------------------------------------
+
+	void Build()
+	{
+		u32 numTags;
+		auto tags = mConverter.GetTags(numTags);
+		if (!tags) {
+			numTags = 0;
+		}
+
+		mResourcesByTag.resize(numTags);
+		for (u32 i = 0; numTags > i; ++i) {
+			mTagBits.emplace(tags[i].mValue, i);
+		}
+
+		u32 numEntities;
+		auto entities = mConverter.GetEntities(numEntities);
+		for (u32 i = 0; numEntities > i; ++i)
+		{
+			for (u32 j = 0; entities[i].mComponentCount > j; ++j)
+			{
+				auto& list = mEntitiesByComponent[entities[i].mComponents[j].mName.mValue];
+				if (list.empty() || list.back() != i) {
+					list.push_back(i);
+				}
+			}
+		}
+
+		u32 numComponentEntries;
+		auto componentEntries = mConverter.GetComponentEntries(numComponentEntries);
+		if (!componentEntries) {
+			numComponentEntries = 0;
+		}
+
+		for (u32 i = 0; numComponentEntries > i; ++i)
+		{
+			auto entries = componentEntries[i].mEntries.Get();
+			if (!entries) {
+				continue;
+			}
+
+			for (u32 j = 0; componentEntries[i].mNumEntries > j; ++j) {
+				AddResource(i, &entries[j], numTags);
+			}
+		}
+	}
+
+	void AddResource(u32 component, TrueCrowdDataBase::ResourceEntry* entry, u32 numTags)
+	{
+		const u32 resourceIndex = static_cast<u32>(mResources.size());
+
+		auto model = &entry->mResource;
+		mResources.push_back({ component, model });
+
+		if (auto name = model->mName.Get()) {
+			mResourcesByName[name].push_back(resourceIndex);
+		}
+
+		for (u32 i = 0; numTags > i; ++i)
+		{
+			if (entry->mTagBitFlag.IsSet(i)) {
+				mResourcesByTag[i].push_back(resourceIndex);
+			}
+		}
+
+		auto textureSets = model->mTextureSets.Get();
+		if (!textureSets) {
+			return;
+		}
+
+		for (u32 i = 0; model->mNumTextureSets > i; ++i)
+		{
+			auto textureSet = textureSets[i].Get();
+			if (!textureSet) {
+				continue;
+			}
+
+			const u32 textureSetIndex = static_cast<u32>(mTextureSets.size());
+			mTextureSets.push_back({ resourceIndex, textureSet });
+
+			if (auto name = textureSet->mName.Get()) {
+				mTextureSetsByName[name].push_back(textureSetIndex);
+			}
+
+			auto params = textureSet->mTextureOverrideParams.Get();
+			if (!params) {
+				continue;
+			}
+
+			for (u32 j = 0; textureSet->mNumTextureOverrideParams > j; ++j)
+			{
+				auto& list = mTextureSetsBySampler[params[j].mSampler.mValue];
+				if (list.empty() || list.back() != textureSetIndex) {
+					list.push_back(textureSetIndex);
+				}
+			}
+		}
+	}
+
+	//------------------------------------
+	//	Query
+	//------------------------------------
+
+	void Print(const char* format, ...)
+	{
+		char buf[1024];
+
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+
+		if (mOutput) {
+			*mOutput += buf;
+		}
+		else {
+			qPrintf("%s", buf);
+		}
+	}
+
+	static u32 ParseSymbol(const char* str)
+	{
+		if (*str == '~') {
+			return strtoul(&str[1], 0, 16);
+		}
+
+		if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+			return strtoul(str, 0, 16);
+		}
+
+		return qStringHash32(str);
+	}
+
+	void PrintResource(u32 index)
+	{
+		auto& resource = mResources[index];
+		Print("\t%s/%s\n", mConverter.GetComponents()[resource.mComponent].mName, resource.mModel->mName.Get());
+	}
+
+	void PrintTextureSet(u32 index)
+	{
+		auto& textureSet = mTextureSets[index];
+		auto& resource = mResources[textureSet.mResource];
+		Print("\t%s/%s/%s\n", mConverter.GetComponents()[resource.mComponent].mName, resource.mModel->mName.Get(), textureSet.mTextureSet->mName.Get());
+	}
+
+	template <typename Map, typename Key>
+	static const std::vector<u32>* Find(const Map& map, const Key& key)
+	{
+		auto it = map.find(key);
+		return (it != map.end() ? &it->second : 0);
+	}
+
+	/* Runs a single "<kind> <value>" query, returns 0 if it could not be parsed. */
+	bool Run(const char* kind, const char* value)
+	{
+		u32 numResults = 0;
+
+		if (!strcmp(kind, "tag"))
+		{
+			auto it = mTagBits.find(ParseSymbol(value));
+			if (it != mTagBits.end())
+			{
+				for (auto index : mResourcesByTag[it->second]) {
+					PrintResource(index);
+				}
+
+				numResults = static_cast<u32>(mResourcesByTag[it->second].size());
+			}
+		}
+		else if (!strcmp(kind, "name"))
+		{
+			if (auto list = Find(mResourcesByName, std::string_view(value)))
+			{
+				for (auto index : *list) {
+					PrintResource(index);
+				}
+
+				numResults += static_cast<u32>(list->size());
+			}
+
+			if (auto list = Find(mTextureSetsByName, std::string_view(value)))
+			{
+				for (auto index : *list) {
+					PrintTextureSet(index);
+				}
+
+				numResults += static_cast<u32>(list->size());
+			}
+		}
+		else if (!strcmp(kind, "sampler"))
+		{
+			if (auto list = Find(mTextureSetsBySampler, ParseSymbol(value)))
+			{
+				for (auto index : *list) {
+					PrintTextureSet(index);
+				}
+
+				numResults = static_cast<u32>(list->size());
+			}
+		}
+		else if (!strcmp(kind, "component"))
+		{
+			if (auto list = Find(mEntitiesByComponent, ParseSymbol(value)))
+			{
+				u32 numEntities;
+				auto entities = mConverter.GetEntities(numEntities);
+
+				for (auto index : *list) {
+					Print("\t%s\n", mConverter.qSymbolStr(entities[index].mNameUID));
+				}
+
+				numResults = static_cast<u32>(list->size());
+			}
+		}
+		else
+		{
+			Print("ERROR: Unknown query %s, expected tag, name, sampler or component.\n", kind);
+			return 0;
+		}
+
+		Print("%s %s: %u result(s)\n", kind, value, numResults);
+		return 1;
+	}
+
+	/* Runs every ';' separated query of the line. */
+	bool RunLine(const char* line)
+	{
+		bool result = 1;
+		std::string query;
+
+		for (const char* it = line;; ++it)
+		{
+			if (*it && *it != ';')
+			{
+				query += *it;
+				continue;
+			}
+
+			const size_t kindBegin = query.find_first_not_of(" \t\r\n");
+			if (kindBegin != std::string::npos)
+			{
+				const size_t kindEnd = query.find_first_of(" \t", kindBegin);
+				const size_t valueBegin = (kindEnd != std::string::npos ? query.find_first_not_of(" \t", kindEnd) : std::string::npos);
+
+				if (valueBegin == std::string::npos)
+				{
+					Print("ERROR: Query \"%s\" is missing a value.\n", query.c_str() + kindBegin);
+					result = 0;
+				}
+				else
+				{
+					const size_t valueEnd = query.find_last_not_of(" \t\r\n");
+					const std::string kind = query.substr(kindBegin, kindEnd - kindBegin);
+					const std::string value = query.substr(valueBegin, valueEnd + 1 - valueBegin);
+
+					result &= Run(kind.c_str(), value.c_str());
+				}
+			}
+
+			query.clear();
+
+			if (!*it) {
+				break;
+			}
+		}
+
+		fflush(stdout);
+		return result;
+	}
+
+	/* Runs queries line by line until the end of the input. */
+	bool RunStream(std::istream& input)
+	{
+		bool result = 1;
+		for (std::string line; std::getline(input, line);) {
+			result &= RunLine(line.c_str());
+		}
+
+		return result;
+	}
+};
+
+/* Loads a binary database and runs the ';' separated queries on it, results go to output when given. */
+inline bool QueryFile(const qString& filename, const char* queries, const TCJobOptions& options, std::string* output)
+{
+	TCDatabaseLoader loader;
+	if (!loader.Load(filename, !options.mNoMapping)) {
+		return 0;
+	}
+
+	TCDatabaseQuery query = { loader.mDB, loader.mVersion };
+	query.mOutput = output;
+	return query.RunLine(queries);
+}
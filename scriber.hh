@@ -1,15 +1,48 @@
 #pragma once
-#include <map>
+#include <algorithm>
+#include <cstdarg>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "cache.hh"
+#include "dedup.hh"
+#include "layout.hh"
+#include "stats.hh"
+#include "stage.hh"
+#include "threadpool.hh"
 
 using namespace UFG;
 
+enum ETCXMLParser
+{
+	TCXML_PARSER_DOCUMENT,	// SimpleXML::XMLDocument, the default
+	TCXML_PARSER_STREAM		// Stage parser of -stream
+};
+
+/* Illusion::GetSchema() is a process wide singleton, a scriber holds this from AllocateSchema until ReleaseSchema. */
+inline std::mutex& GetSchemaMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
 class TCDatabaseScriber
 {
 public:
 	TrueCrowdDataBase* mDB;
 	u32 mByteSize = 0;
 
+	/* Held from AllocateSchema while mDB points into the schema, other scribers parse and count in the meantime. */
+	std::unique_lock<std::mutex> mSchemaLock;
+
 	SimpleXML::XMLDocument* mXML;
+	TCDatabaseStage* mStage;
+
+	/* Backs the stage, symbols, fixups and indexes below, the heap is used without one. The caller resets it once the scriber is gone. */
+	TCArena* mArena;
 
 	// Resource
 
@@ -27,9 +60,43 @@ public:
 	char* mStrBuffer;
 	u32 mStrLen = 0;
 
+	// StringBuffer pooling, identical names share one copy. Names are collected while counting and get their offset from the first AppendStringBuffer.
+
+	static constexpr u32 UnassignedString = ~0u;
+
+	bool mPoolStrings = 0;
+	TCArenaHashMap<std::string_view, u32> mStringPool{ TCArenaAllocator<std::pair<const std::string_view, u32>>(mArena) };
+	u32 mUnpooledStringBufferSize = 0;
+
+	// Content dedup, identical texture sets, colour tint and override param arrays are written once. A texture set is read into mContent* before it is counted or built.
+
+	bool mDedup = 0;
+	TCDedupTable mColourTintTable{ mArena };
+	TCDedupTable mOverrideParamTable{ mArena };
+	TCDedupTable mTextureSetTable{ mArena };
+
+	const char* mContentName = 0;
+	const char* mContentHighResolutionResource = 0;
+	TCArenaVector<qColour> mContentColourTints{ TCArenaAllocator<qColour>(mArena) };
+	TCArenaVector<TextureOverrideParams> mContentOverrideParams{ TCArenaAllocator<TextureOverrideParams>(mArena) };
+	TCArenaVector<u8> mContentKey{ TCArenaAllocator<u8>(mArena) };
+
+	u32 mNumTextureSetRefs = 0;
+	u32 mNumSharedTextureSets = 0;
+	u32 mNumSharedColourTints = 0;
+	u32 mNumSharedOverrideParams = 0;
+
 	u32 mComponentTypeSymbolUC = 0;
 
-	std::map<u32, const char*> mSymbols;
+	// Every CreateSymbol call is appended, SortSymbols turns this into a sorted list where the last string of a symbol wins.
+
+	struct Symbol
+	{
+		u32 mUID;
+		const char* mStr;
+	};
+
+	TCArenaVector<Symbol> mSymbols{ TCArenaAllocator<Symbol>(mArena) };
 
 	struct qResourceOffsetFix
 	{
@@ -38,23 +105,143 @@ public:
 		bool mIsTextureSet;
 	};
 
-	std::vector<qResourceOffsetFix> mTrueCrowdResourceOffsetFixes;
+	TCArenaVector<qResourceOffsetFix> mTrueCrowdResourceOffsetFixes{ TCArenaAllocator<qResourceOffsetFix>(mArena) };
+
+	// Name -> resource lookup used to resolve the offset fixes, models and texture sets are kept separate.
+
+	TCArenaHashMap<std::string_view, TrueCrowdResource*> mModelIndex{ TCArenaAllocator<std::pair<const std::string_view, TrueCrowdResource*>>(mArena) };
+	TCArenaHashMap<std::string_view, TrueCrowdResource*> mTextureSetIndex{ TCArenaAllocator<std::pair<const std::string_view, TrueCrowdResource*>>(mArena) };
+
+	// Tag string -> symbol and symbol -> bit index, the latter is built once the <Tags> list is scribed.
+
+	TCArenaHashMap<std::string_view, u32> mTagSymbols{ TCArenaAllocator<std::pair<const std::string_view, u32>>(mArena) };
+	TCArenaHashMap<u32, u32> mTagIndex{ TCArenaAllocator<std::pair<const u32, u32>>(mArena) };
+	u32 mNumUnknownTags = 0;
+
+	// Incremental build, components found in mCache are copied instead of built. The components of this build are collected in mCacheComponents.
+
+	TCDatabaseCache* mCache = 0;
+	std::vector<TCDatabaseCache::Component> mCacheComponents;
+	std::vector<TCDatabaseCache::Symbol>* mRecordSymbols = 0;
+	u64 mCacheKey = 0;
+	u32 mNumReusedComponents = 0;
+
+	TCStats* mStats = 0;
+
+	/* Element counts of the schema arrays. */
+	struct SchemaCounts
+	{
+		u32 mNumTags = 0;
+		u32 mNumComponentEntries = 0;
+		u32 mNumResourceEntries = 0;
+		u32 mNumLODs = 0;
+		u32 mNumModelParts = 0;
+		u32 mNumTextureSetOffsets = 0;
+		u32 mNumTextureSets = 0;
+		u32 mNumColourTints = 0;
+		u32 mNumTextureOverrideParams = 0;
+		u32 mStringBufferSize = 0;
+	};
+
+	// Parallel build, components are built on mPool from the cursors in mComponentCounts (running totals at the start of each component, the last entry holds the sums).
+	// A worker has mParent set, it defers resource registration and buffers its warnings in mLog so the parent can merge both in component order.
+
+	ThreadPool* mPool = 0;
+	TCArenaVector<SchemaCounts> mComponentCounts{ TCArenaAllocator<SchemaCounts>(mArena) };
+
+	const TCDatabaseScriber* mParent = 0;
+	std::string mLog;
+
+	struct RegisteredResource
+	{
+		TrueCrowdResource* mResource;
+		bool mIsTextureSet;
+		size_t mLogOffset;	// Length of mLog when the resource was built
+	};
+
+	std::vector<RegisteredResource> mRegisteredResources;
+
+	bool mOwnsSource = 1;
 
-	TCDatabaseScriber(const qString& filename) : mDB(0)
+	/* Layout of the output, selected once in Build. */
+	ETCDatabaseVersion mVersion = TCDB_VERSION_SDHD;
+
+	TCDatabaseScriber(const qString& filename, ETCXMLParser parser = TCXML_PARSER_DOCUMENT, TCArena* arena = 0) : mDB(0), mXML(0), mStage(0), mArena(arena)
 	{
-		mXML = SimpleXML::XMLDocument::Open(filename);
+		if (parser == TCXML_PARSER_DOCUMENT)
+		{
+			mXML = SimpleXML::XMLDocument::Open(filename);
+			return;
+		}
+
+		mStage = new TCDatabaseStage(arena);
+		if (!mStage->Open(filename))
+		{
+			delete mStage;
+			mStage = 0;
+		}
 	}
 
+	/* Takes ownership of an already parsed stage, which must use the same arena. */
+	TCDatabaseScriber(TCDatabaseStage* stage) : mDB(0), mXML(0), mStage(stage), mArena(stage->mArena) {}
+
 	~TCDatabaseScriber()
 	{
-		qDelete(mXML);
+		if (mOwnsSource)
+		{
+			qDelete(mXML);
+			delete mStage;
+		}
+
 		mXML = 0;
+		mStage = 0;
+	}
+
+	/* Worker of a parallel build, shares the source and output of the parent and starts at the cursors of component index. */
+	TCDatabaseScriber(const TCDatabaseScriber& parent, u32 index) : mDB(parent.mDB), mXML(parent.mXML), mStage(parent.mStage), mArena(0)
+	{
+		mParent = &parent;
+		mOwnsSource = 0;
+		mVersion = parent.mVersion;
+
+		mResourceEntry = parent.mResourceEntry;
+		mLOD = parent.mLOD;
+		mModelPart = parent.mModelPart;
+		mTextureSetArray = parent.mTextureSetArray;
+		mTextureSet = parent.mTextureSet;
+		mColourTints = parent.mColourTints;
+		mTextureOverrideParams = parent.mTextureOverrideParams;
+		mStrBuffer = parent.mStrBuffer;
+		mStrLen = parent.mStrLen;
+		AdvanceCursors(parent.mComponentCounts[index]);
+
+		mTagIndex.insert(parent.mTagIndex.begin(), parent.mTagIndex.end());
 	}
 
+	bool IsLoaded() const { return mXML || mStage; }
+
 	//------------------------------------
 	//	Helpers
 	//------------------------------------
 
+	/* Prints right away, or into mLog on a parallel build worker. */
+	void Report(const char* format, ...)
+	{
+		char buf[1024];
+
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+
+		if (mParent) {
+			mLog += buf;
+		}
+		else {
+			qPrintf("%s", buf);
+		}
+	}
+
 	u32 CreateSymbol(const char* str, bool uppercase)
 	{
 		if (*str == '~') {
@@ -62,7 +249,24 @@ public:
 		}
 
 		u32 sym = (uppercase ? qStringHashUpper32(str) : qStringHash32(str));
-		mSymbols[sym] = str;
+		mSymbols.push_back({ sym, str });
+
+		if (mRecordSymbols) {
+			mRecordSymbols->push_back({ sym, str });
+		}
+
+		return sym;
+	}
+
+	u32 CreateTagSymbol(const char* str)
+	{
+		auto it = mTagSymbols.find(str);
+		if (it != mTagSymbols.end()) {
+			return it->second;
+		}
+
+		const u32 sym = CreateSymbol(str, 0);
+		mTagSymbols.emplace(str, sym);
 		return sym;
 	}
 
@@ -81,36 +285,32 @@ public:
 		}
 	}
 
-	TrueCrowdResource* FindCrowdResource(const char* name, bool isTextureSet)
+	void RegisterCrowdResource(TrueCrowdResource* resource, bool isTextureSet)
 	{
-		auto componentEntry = mDB->mComponentEntries.Get();
-		for (u32 i = 0; mDB->mNumComponentEntries > i; ++i, ++componentEntry)
+		if (mParent)
 		{
-			auto resourceEntry = componentEntry->mEntries.Get();
-			for (u32 j = 0; componentEntry->mNumEntries > j; ++j, ++resourceEntry)
-			{
-				if (isTextureSet)
-				{
-					auto textureSets = resourceEntry->mResource.mTextureSets.Get();
-					for (u32 k = 0; resourceEntry->mResource.mNumTextureSets > k; ++k, ++textureSets)
-					{
-						auto textureSet = textureSets->Get();
-						auto textureSetName = textureSet->mName.Get();
-						if (!qStringCompare(textureSetName, name)) {
-							return textureSet;
-						}
-					}
-					continue;
-				}
+			mRegisteredResources.push_back({ resource, isTextureSet, mLog.size() });
+			return;
+		}
 
-				auto resourceName = resourceEntry->mResource.mName.Get();
-				if (!qStringCompare(resourceName, name)) {
-					return &resourceEntry->mResource;
-				}
-			}
+		auto name = resource->mName.Get();
+		auto& index = (isTextureSet ? mTextureSetIndex : mModelIndex);
+
+		if (!index.emplace(name, resource).second) {
+			qPrintf("WARN: Duplicate %s name %s, HighResolutionResource will reference the first one.\n", (isTextureSet ? "TextureSet" : "Model"), name);
 		}
+	}
+
+	TrueCrowdResource* FindCrowdResource(const char* name, bool isTextureSet)
+	{
+		auto& index = (isTextureSet ? mTextureSetIndex : mModelIndex);
 
-		return 0;
+		auto it = index.find(name);
+		if (it == index.end()) {
+			return 0;
+		}
+
+		return it->second;
 	}
 
 	//------------------------------------
@@ -125,10 +325,42 @@ public:
 		mDB->mTypeUID = RTypeUID_TrueCrowdDataBase;
 	}
 
+	/* Returns the bytes the string adds to the StringBuffer, 0 if pooling already has it. */
+	u32 CountBufferString(const char* str)
+	{
+		const u32 size = static_cast<u32>(qStringLength(str)) + 1;
+		mUnpooledStringBufferSize += size;
+
+		if (mPoolStrings && !mStringPool.emplace(str, UnassignedString).second) {
+			return 0;
+		}
+
+		return size;
+	}
+
 	const char* AppendStringBuffer(const char* str)
 	{
+		u32* pooledOffset = 0;
+		if (mPoolStrings)
+		{
+			auto it = mStringPool.find(str);
+			if (it != mStringPool.end())
+			{
+				if (it->second != UnassignedString) {
+					return &mStrBuffer[it->second];
+				}
+
+				pooledOffset = &it->second;
+			}
+		}
+
 		int len = qStringLength(str);
 		char* buf = &mStrBuffer[mStrLen];
+
+		if (pooledOffset) {
+			*pooledOffset = mStrLen;
+		}
+
 		mStrLen += len + 1;
 
 		qMemCopy(buf, str, len);
@@ -152,33 +384,47 @@ public:
 		resource->mPropSetName = buf.GetStringHash32();
 	}
 
-	void BuildTagBitFlags(BitFlags128* bitFlags, SimpleXML::XMLNode* node)
+	void BuildTagIndex(const qSymbol* tags, u32 numTags)
 	{
-		auto definition = &mDB->mDefinition;
-		auto tags = definition->mTagList.Get();
+		mTagIndex.reserve(numTags);
+
+		for (u32 i = 0; numTags > i; ++i) {
+			mTagIndex.emplace(tags[i], i);
+		}
+	}
 
-		for (auto tag = mXML->GetChildNode(XTag_Tag, node); tag; tag = mXML->GetNode(XTag_Tag, tag))
+	void BuildTagBit(BitFlags128* bitFlags, const char* resourceName, const char* tagStr)
+	{
+		auto it = mTagIndex.find(CreateTagSymbol(tagStr));
+		if (it == mTagIndex.end())
 		{
-			auto tagStr = tag->GetValue();
-			const u32 tagUID = CreateSymbol(tagStr, 0);
-			for (u32 i = 0; definition->mNumTags > i; ++i)
-			{
-				if (tags[i] == tagUID)
-				{
-					bitFlags->Set(i);
-					break;
-				}
-			}
+			Report("WARN: Resource %s references tag %s that is not listed in <%s>.\n", resourceName, tagStr, XTag_Tags);
+			++mNumUnknownTags;
+			return;
 		}
+
+		bitFlags->Set(it->second);
 	}
 
-	void BuildModelPart(TrueCrowdModelPart* modelPart, SimpleXML::XMLNode* node)
+	void BuildTagBitFlags(BitFlags128* bitFlags, const char* resourceName, SimpleXML::XMLNode* node)
+	{
+		for (auto tag = mXML->GetChildNode(XTag_Tag, node); tag; tag = mXML->GetNode(XTag_Tag, tag)) {
+			BuildTagBit(bitFlags, resourceName, tag->GetValue());
+		}
+	}
+
+	void BuildModelPart(TrueCrowdModelPart* modelPart, const char* modelName, int isSkinned, int morphType)
 	{
-		const char* name = AppendStringBuffer(node->GetAttribute(XAttr_Name));
+		const char* name = AppendStringBuffer(modelName);
 		modelPart->mModelName.Set(name);
 		modelPart->mModelNameHash = CreateSymbol(name, 1);
-		modelPart->mIsSkinned = node->GetAttribute(XAttr_IsSkinned, 0);
-		modelPart->mMorphType = node->GetAttribute(XAttr_MorphType, 0);
+		modelPart->mIsSkinned = isSkinned;
+		modelPart->mMorphType = morphType;
+	}
+
+	void BuildModelPart(TrueCrowdModelPart* modelPart, SimpleXML::XMLNode* node)
+	{
+		BuildModelPart(modelPart, node->GetAttribute(XAttr_Name), node->GetAttribute(XAttr_IsSkinned, 0), node->GetAttribute(XAttr_MorphType, 0));
 	}
 
 	void BuildLODModel(TrueCrowdLOD* lod, SimpleXML::XMLNode* node)
@@ -197,9 +443,26 @@ public:
 		}
 	}
 
+	void BuildColourTint(qColour* tint, int r, int g, int b)
+	{
+		tint->r = static_cast<f32>(r / 255.f);
+		tint->g = static_cast<f32>(g / 255.f);
+		tint->b = static_cast<f32>(b / 255.f);
+	}
+
+	void BuildTextureOverrideParam(TextureOverrideParams* param, const char* sampler, u32 nameUID, u32 uid0, u32 uid1, u32 uid2)
+	{
+		param->mSampler = CreateSymbol(sampler, 0);
+		param->mTextureNameUID = nameUID;
+		param->mTextureOverrideUID[0] = uid0;
+		param->mTextureOverrideUID[1] = uid1;
+		param->mTextureOverrideUID[2] = uid2;
+	}
+
 	void BuildTextureSet(TrueCrowdTextureSet* textureSet, int type, SimpleXML::XMLNode* node)
 	{
 		BuildResource(textureSet, node->GetAttribute(XAttr_Name), type);
+		RegisterCrowdResource(textureSet, 1);
 
 		auto colourTint = mXML->GetChildNode(XTag_ColourTint, node);
 		if (colourTint)
@@ -208,12 +471,7 @@ public:
 
 			for (; colourTint; colourTint = mXML->GetNode(XTag_ColourTint, colourTint))
 			{
-				auto tint = mColourTints++;
-
-				tint->r = static_cast<f32>(colourTint->GetAttribute("r", 0) / 255.f);
-				tint->g = static_cast<f32>(colourTint->GetAttribute("g", 0) / 255.f);
-				tint->b = static_cast<f32>(colourTint->GetAttribute("b", 0) / 255.f);
-
+				BuildColourTint(mColourTints++, colourTint->GetAttribute("r", 0), colourTint->GetAttribute("g", 0), colourTint->GetAttribute("b", 0));
 				++textureSet->mNumColorTints;
 			}
 		}
@@ -225,13 +483,8 @@ public:
 
 			for (; overrideParam; overrideParam = mXML->GetNode(XTag_OverrideParam, overrideParam))
 			{
-				auto param = mTextureOverrideParams++;
-
-				param->mSampler = CreateSymbol(overrideParam->GetAttribute(XAttr_Sampler), 0);
-				param->mTextureNameUID = overrideParam->GetAttribute(XAttr_NameUID, 0u);
-				param->mTextureOverrideUID[0] = overrideParam->GetAttribute(XAttr_UID0, 0u);
-				param->mTextureOverrideUID[1] = overrideParam->GetAttribute(XAttr_UID1, 0u);
-				param->mTextureOverrideUID[2] = overrideParam->GetAttribute(XAttr_UID2, 0u);
+				BuildTextureOverrideParam(mTextureOverrideParams++, overrideParam->GetAttribute(XAttr_Sampler), overrideParam->GetAttribute(XAttr_NameUID, 0u),
+					overrideParam->GetAttribute(XAttr_UID0, 0u), overrideParam->GetAttribute(XAttr_UID1, 0u), overrideParam->GetAttribute(XAttr_UID2, 0u));
 
 				++textureSet->mNumTextureOverrideParams;
 			}
@@ -249,11 +502,12 @@ public:
 		int type = node->GetAttribute(XAttr_Type, TrueCrowdResource::Invalid);
 
 		if (type == TrueCrowdResource::Invalid)	{
-			qPrintf("WARN: Resource %s has an invalid type specified.\n", name);
+			Report("WARN: Resource %s has an invalid type specified.\n", name);
 		}
 
-		BuildTagBitFlags(&entry->mTagBitFlag, node);
+		BuildTagBitFlags(&entry->mTagBitFlag, name, node);
 		BuildResource(model, name, type);
+		RegisterCrowdResource(model, 0);
 
 		model->mComponentTypeSymbolUC = mComponentTypeSymbolUC;
 
@@ -280,8 +534,17 @@ public:
 
 			for (; textureSet; textureSet = mXML->GetNode(XTag_TextureSet, textureSet))
 			{
-				BuildTextureSet(mTextureSet, type, textureSet);
-				mTextureSetArray->Set(mTextureSet++);
+				if (mDedup)
+				{
+					ReadTextureSetContent(textureSet);
+					mTextureSetArray->Set(BuildSharedTextureSet(type));
+				}
+				else
+				{
+					BuildTextureSet(mTextureSet, type, textureSet);
+					mTextureSetArray->Set(mTextureSet++);
+				}
+
 				++mTextureSetArray;
 
 				++model->mNumTextureSets;	
@@ -289,13 +552,17 @@ public:
 		}
 	}
 
-	void BuildComponent(TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, SimpleXML::XMLNode* node)
+	void BuildComponentName(TrueCrowdDefinition::Component* component, const char* name)
 	{
-		const char* name = node->GetAttribute(XAttr_Name);
 		strcpy(component->mName, name);
 		component->mNameUID = CreateSymbol(name, 1);
 
 		mComponentTypeSymbolUC = component->mNameUID;
+	}
+
+	void BuildComponent(TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, SimpleXML::XMLNode* node)
+	{
+		BuildComponentName(component, node->GetAttribute(XAttr_Name));
 
 		auto resource = mXML->GetChildNode(XTag_Resource, node);
 		if (!resource) {
@@ -337,13 +604,57 @@ public:
 		}
 	}
 
-	bool BuildSchema()
+	template <typename Layout>
+	bool AllocateSchema(const SchemaCounts& counts)
 	{
+		if (counts.mNumComponentEntries > TCDatabaseLayout<Layout>::MaxComponents)
+		{
+			qPrintf("ERROR: %u <%s> exceed the %u components of the %s layout.\n", counts.mNumComponentEntries, XTag_Component, TCDatabaseLayout<Layout>::MaxComponents, TCDatabaseLayouts::GetName(Layout::Version));
+			return 0;
+		}
+
+		mSchemaLock = std::unique_lock<std::mutex>(GetSchemaMutex());
+
 		auto schema = Illusion::GetSchema(); 
 		
 		schema->Init();
-		schema->Add("TrueCrowdDatabase", &mDB);
+		schema->Add("TrueCrowdDatabase", TCDatabaseLayout<Layout>::Size, (void**)&mDB);
+
+		if (counts.mNumTags) {
+			schema->AddArray<qSymbol>("TagList", counts.mNumTags, 0, &TCDatabaseLayout<Layout>::GetTagBlock(mDB)->mTagList);
+		}
+		else {
+			qPrintf("WARN: Missing XML tag <%s> inside <%s>. Was this intended?", XTag_Tags, XTag_Definition);
+		}
+
+		if (counts.mNumComponentEntries) {
+			schema->AddArray<TrueCrowdDataBase::ComponentEntries>("ComponentEntries", counts.mNumComponentEntries, 0, &TCDatabaseLayout<Layout>::GetComponentEntryBlock(mDB)->mComponentEntries);
+		}
+
+		schema->AddArray("ResourceEntries", counts.mNumResourceEntries, &mResourceEntry);
+		schema->AddArray("LODs", counts.mNumLODs, &mLOD);
+		schema->AddArray("ModelParts", counts.mNumModelParts, &mModelPart);
+		schema->AddArray("TextureSetArray", counts.mNumTextureSetOffsets, &mTextureSetArray);
+		schema->AddArray("TextureSets", counts.mNumTextureSets, &mTextureSet);
+		schema->AddArray("ColourTints", counts.mNumColourTints, &mColourTints);
+		schema->AddArray("TextureOverrideParams", counts.mNumTextureOverrideParams, &mTextureOverrideParams);
+		schema->Add("StringBuffer", counts.mStringBufferSize, (void**)&mStrBuffer);
+
+		{
+			TCStats::ScopedPhase phase(mStats, "allocate");
+			schema->Allocate();
+		}
+
+		mModelIndex.reserve(counts.mNumResourceEntries);
+		mTextureSetIndex.reserve(counts.mNumTextureSets);
+
+		mByteSize = static_cast<u32>(schema->mCurrSize);
+		return 1;
+	}
 
+	template <typename Layout>
+	bool BuildSchema()
+	{
 		auto xDB = mXML->GetChildNode(XTag_TCDB);
 		if (!xDB)
 		{
@@ -365,154 +676,1101 @@ public:
 			return 0;
 		}
 
-		auto xTags = mXML->GetChildNode(XTag_Tags, xDefinition);
-		const u32 numTags = xTags->GetChildCount();
-		if (numTags) {
-			schema->AddArray<qSymbol>("TagList", numTags, 0, &mDB->mDefinition.mTagList);
-		}
-		else {
-			qPrintf("WARN: Missing XML tag <%s> inside <%s>. Was this intended?", XTag_Tags, XTag_Definition);
-		}
-
-		const u32 numComponentEntries = xComponentEntries->GetChildCount();
-		if (numComponentEntries) {
-			schema->AddArray<TrueCrowdDataBase::ComponentEntries>("ComponentEntries", numComponentEntries, 0, &mDB->mComponentEntries);
-		}
-
 		/* Precalculate required stuff. */
 
-		u32 numResourceEntries = 0;
-		u32 numLODs = 0;
-		u32 numModelParts = 0;
-		u32 numTextureSets = 0;
-		u32 numColourTints = 0;
-		u32 numTextureOverrideParams = 0;
+		auto start = TCStats::Clock::now();
+		SchemaCounts counts;
 
-		u32 strsSize = 0;
+		auto xTags = mXML->GetChildNode(XTag_Tags, xDefinition);
+		counts.mNumTags = xTags->GetChildCount();
+		counts.mNumComponentEntries = xComponentEntries->GetChildCount();
+
+		const bool parallel = CanBuildParallel();
+		u32 numResources = 0;
 
 		for (auto component = mXML->GetChildNode(XTag_Component, xComponentEntries); component; component = mXML->GetNode(XTag_Component, component))
 		{
-			numResourceEntries += component->GetChildCount();
+			if (parallel) {
+				AddComponentCounts(counts, numResources);
+			}
+
+			counts.mNumResourceEntries += component->GetChildCount();
 
 			for (auto resource = mXML->GetChildNode(XTag_Resource, component); resource; resource = mXML->GetNode(XTag_Resource, resource))
 			{
-				strsSize += qStringLength(resource->GetAttribute(XAttr_Name)) + 1;
+				++numResources;
+				counts.mStringBufferSize += CountBufferString(resource->GetAttribute(XAttr_Name));
 
 				for (auto lod = mXML->GetChildNode(XTag_LOD, resource); lod; lod = mXML->GetNode(XTag_LOD, lod))
 				{
-					++numLODs;
+					++counts.mNumLODs;
 
 					for (auto modelPart = mXML->GetChildNode(XTag_ModelPart, lod); modelPart; modelPart = mXML->GetNode(XTag_ModelPart, modelPart))
 					{
-						strsSize += qStringLength(modelPart->GetAttribute(XAttr_Name)) + 1;
-						++numModelParts;
+						counts.mStringBufferSize += CountBufferString(modelPart->GetAttribute(XAttr_Name));
+						++counts.mNumModelParts;
 					}
 				}
 
 				for (auto textureSet = mXML->GetChildNode(XTag_TextureSet, resource); textureSet; textureSet = mXML->GetNode(XTag_TextureSet, textureSet))
 				{
-					strsSize += qStringLength(textureSet->GetAttribute(XAttr_Name)) + 1;
-					++numTextureSets;
+					++counts.mNumTextureSetOffsets;
+
+					if (mDedup)
+					{
+						ReadTextureSetContent(textureSet);
+						if (CountTextureSetContent(resource->GetAttribute(XAttr_Type, TrueCrowdResource::Invalid), counts)) {
+							counts.mStringBufferSize += CountBufferString(mContentName);
+						}
+
+						continue;
+					}
+
+					counts.mStringBufferSize += CountBufferString(textureSet->GetAttribute(XAttr_Name));
+					++counts.mNumTextureSets;
 
 					for (auto colourTint = mXML->GetChildNode(XTag_ColourTint, textureSet); colourTint; colourTint = mXML->GetNode(XTag_ColourTint, colourTint)) {
-						++numColourTints;
+						++counts.mNumColourTints;
 					}
 
 					for (auto overrideParam = mXML->GetChildNode(XTag_OverrideParam, textureSet); overrideParam; overrideParam = mXML->GetNode(XTag_OverrideParam, overrideParam)) {
-						++numTextureOverrideParams;
+						++counts.mNumTextureOverrideParams;
 					}
 				}
 			}
 		}
 
-		schema->AddArray("ResourceEntries", numResourceEntries, &mResourceEntry);
-		schema->AddArray("LODs", numLODs, &mLOD);
-		schema->AddArray("ModelParts", numModelParts, &mModelPart);
-		schema->AddArray("TextureSetArray", numTextureSets, &mTextureSetArray);
-		schema->AddArray("TextureSets", numTextureSets, &mTextureSet);
-		schema->AddArray("ColourTints", numColourTints, &mColourTints);
-		schema->AddArray("TextureOverrideParams", numTextureOverrideParams, &mTextureOverrideParams);
-		schema->Add("StringBuffer", strsSize, (void**)&mStrBuffer);
+		if (parallel) {
+			AddComponentCounts(counts, numResources);
+		}
 
-		schema->Allocate();
+		if (mStats) {
+			mStats->AddPhase("schema_count", start);
+		}
 
-		mByteSize = static_cast<u32>(schema->mCurrSize);
-		return 1;
+		return AllocateSchema<Layout>(counts);
 	}
 
-	bool Build()
+	bool ResolveResourceOffsetFixes()
 	{
-		if (!BuildSchema()) {
-			return 0;
+		TCStats::ScopedPhase phase(mStats, "offset_fixups");
+
+		for (auto& resourceFix : mTrueCrowdResourceOffsetFixes)
+		{
+			auto resource = FindCrowdResource(resourceFix.mName, resourceFix.mIsTextureSet);
+			if (!resource)
+			{
+				qPrintf("ERROR: Failed to fix resource offset for %s (%s)\n", resourceFix.mName, (resourceFix.mIsTextureSet ? "TextureSet" : "Model"));
+				return 0;
+			}
+
+			resourceFix.mOffset->Set(resource);
 		}
 
-		BuildResource();
+		if (mNumUnknownTags) {
+			qPrintf("WARN: %u unknown tag reference(s) were ignored.\n", mNumUnknownTags);
+		}
 
-		auto definition = &mDB->mDefinition;
+		return 1;
+	}
 
-		auto xDB = mXML->GetChildNode(XTag_TCDB);
-		auto xDefinition = mXML->GetChildNode(XTag_Definition, xDB);
-		auto xComponentEntries = mXML->GetChildNode(XTag_ComponentEntries, xDB);
+	/* Sorts by UID and keeps the last string of each, stable so the result matches a map assigned in call order. */
+	void SortSymbols()
+	{
+		std::stable_sort(mSymbols.begin(), mSymbols.end(), [](const Symbol& a, const Symbol& b) { return a.mUID < b.mUID; });
 
-		for (auto entity = mXML->GetChildNode(XTag_Entity, xDefinition); entity; entity = mXML->GetNode(XTag_Entity, entity)) {
-			BuildEntity(&definition->mEntities[definition->mEntityCount++], entity);
+		size_t numSymbols = 0;
+		for (auto& symbol : mSymbols)
+		{
+			if (numSymbols && mSymbols[numSymbols - 1].mUID == symbol.mUID) {
+				mSymbols[numSymbols - 1].mStr = symbol.mStr;
+			}
+			else {
+				mSymbols[numSymbols++] = symbol;
+			}
 		}
 
-		auto tagList = definition->mTagList.Get();
+		mSymbols.resize(numSymbols);
+	}
 
-		auto xTags = mXML->GetChildNode(XTag_Tags, xDefinition);
-		for (auto tag = mXML->GetChildNode(XTag_Tag, xTags); tag; tag = mXML->GetNode(XTag_Tag, tag)) {
-			tagList[definition->mNumTags++] = CreateSymbol(tag->GetValue(), 0);
+	bool Build()
+	{
+		bool result;
+		if (mVersion == TCDB_VERSION_TW) {
+			result = (mStage ? BuildStaged<TCLayoutTW>() : BuildDocument<TCLayoutTW>());
+		}
+		else {
+			result = (mStage ? BuildStaged<TCLayoutSDHD>() : BuildDocument<TCLayoutSDHD>());
 		}
 
-		auto componentEntries = mDB->mComponentEntries.Get();
-		for (auto component = mXML->GetChildNode(XTag_Component, xComponentEntries); component; component = mXML->GetNode(XTag_Component, component)) {
-			BuildComponent(&definition->mComponents[definition->mComponentCount++], &componentEntries[mDB->mNumComponentEntries++], component);
+		if (!result) {
+			return 0;
 		}
 
-		for (auto& resourceFix : mTrueCrowdResourceOffsetFixes)
-		{
-			auto resource = FindCrowdResource(resourceFix.mName, resourceFix.mIsTextureSet);
-			if (!resource)
-			{
-				qPrintf("ERROR: Failed to fix resource offset for %s (%s)\n", resourceFix.mName, (resourceFix.mIsTextureSet ? "TextureSet" : "Model"));
-				return 0;
-			}
+		SortSymbols();
 
-			resourceFix.mOffset->Set(resource);
+		if (mPoolStrings) {
+			qPrintf("String pooling saved %u of %u StringBuffer byte(s).\n", mUnpooledStringBufferSize - mStrLen, mUnpooledStringBufferSize);
+		}
+
+		if (mDedup) {
+			qPrintf("Content dedup shared %u of %u texture set(s), %u colour tint and %u override param array(s).\n", mNumSharedTextureSets, mNumTextureSetRefs, mNumSharedColourTints, mNumSharedOverrideParams);
 		}
 
 		return 1;
 	}
 
-	void Export(const char* filename)
+	template <typename Layout>
+	bool BuildDocument()
 	{
-		qString qSymbolsFilename = filename;
-		qSymbolsFilename = qSymbolsFilename.GetFilePathWithoutExtension() + "_qsymbols.txt";
+		if (!BuildSchema<Layout>()) {
+			return 0;
+		}
+
+		BuildResource();
+
+		auto definition = &mDB->mDefinition;
+		auto components = TCDatabaseLayout<Layout>::GetComponents(mDB);
+		auto entityBlock = TCDatabaseLayout<Layout>::GetEntityBlock(mDB);
+		auto tagBlock = TCDatabaseLayout<Layout>::GetTagBlock(mDB);
+		auto componentEntryBlock = TCDatabaseLayout<Layout>::GetComponentEntryBlock(mDB);
+
+		auto xDB = mXML->GetChildNode(XTag_TCDB);
+		auto xDefinition = mXML->GetChildNode(XTag_Definition, xDB);
+		auto xComponentEntries = mXML->GetChildNode(XTag_ComponentEntries, xDB);
 
-		if (auto f = qOpen(qSymbolsFilename, QACCESS_WRITE))
 		{
-			qString buf;
+			TCStats::ScopedPhase phase(mStats, "build_entities");
 
-			for (auto& sym : mSymbols)
-			{
-				buf.Format("0x%08X %s\n", sym.first, sym.second);
-				qWriteString(f, buf, buf.Length());
+			for (auto entity = mXML->GetChildNode(XTag_Entity, xDefinition); entity; entity = mXML->GetNode(XTag_Entity, entity)) {
+				BuildEntity(&entityBlock->mEntities[entityBlock->mEntityCount++], entity);
 			}
-
-			qClose(f);
-			qPrintf("QSymbols has been exported to: %s\n", qSymbolsFilename.mData);
 		}
 
-		qChunkFileBuilder chunkBuilder;
-		chunkBuilder.CreateBuilder("PC64", filename, 0, 0);
+		{
+			TCStats::ScopedPhase phase(mStats, "build_tags");
 
-		chunkBuilder.BeginChunk(ChunkUID_TrueCrowdDataBase, "TrueCrowdDB", 1);
-		chunkBuilder.Write(mDB, mByteSize);
-		chunkBuilder.EndChunk(ChunkUID_TrueCrowdDataBase);
+			auto tagList = tagBlock->mTagList.Get();
 
-		chunkBuilder.CloseBuilder(0, true);
+			auto xTags = mXML->GetChildNode(XTag_Tags, xDefinition);
+			for (auto tag = mXML->GetChildNode(XTag_Tag, xTags); tag; tag = mXML->GetNode(XTag_Tag, tag)) {
+				tagList[tagBlock->mNumTags++] = CreateTagSymbol(tag->GetValue());
+			}
+
+			BuildTagIndex(tagList, tagBlock->mNumTags);
+		}
+
+		{
+			TCStats::ScopedPhase phase(mStats, "build_components");
+
+			auto componentEntries = componentEntryBlock->mComponentEntries.Get();
+			if (CanBuildParallel())
+			{
+				std::vector<SimpleXML::XMLNode*> nodes;
+				for (auto component = mXML->GetChildNode(XTag_Component, xComponentEntries); component; component = mXML->GetNode(XTag_Component, component)) {
+					nodes.push_back(component);
+				}
+
+				const u32 count = static_cast<u32>(nodes.size());
+				BuildComponentsParallel(components, componentEntries, count, [&nodes](TCDatabaseScriber& worker, TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, u32 i)
+				{
+					worker.BuildComponent(component, entry, nodes[i]);
+				});
+
+				definition->mComponentCount += count;
+				componentEntryBlock->mNumComponentEntries += count;
+			}
+			else
+			{
+				for (auto component = mXML->GetChildNode(XTag_Component, xComponentEntries); component; component = mXML->GetNode(XTag_Component, component)) {
+					BuildComponent(&components[definition->mComponentCount++], &componentEntries[componentEntryBlock->mNumComponentEntries++], component);
+				}
+			}
+		}
+
+		return ResolveResourceOffsetFixes();
+	}
+
+	//------------------------------------
+	//	Content Dedup
+	//------------------------------------
+
+	void ReadTextureSetContent(SimpleXML::XMLNode* node)
+	{
+		mContentName = node->GetAttribute(XAttr_Name);
+		mContentColourTints.clear();
+		mContentOverrideParams.clear();
+
+		for (auto colourTint = mXML->GetChildNode(XTag_ColourTint, node); colourTint; colourTint = mXML->GetNode(XTag_ColourTint, colourTint))
+		{
+			mContentColourTints.push_back({});
+			BuildColourTint(&mContentColourTints.back(), colourTint->GetAttribute("r", 0), colourTint->GetAttribute("g", 0), colourTint->GetAttribute("b", 0));
+		}
+
+		for (auto overrideParam = mXML->GetChildNode(XTag_OverrideParam, node); overrideParam; overrideParam = mXML->GetNode(XTag_OverrideParam, overrideParam))
+		{
+			mContentOverrideParams.push_back({});
+			BuildTextureOverrideParam(&mContentOverrideParams.back(), overrideParam->GetAttribute(XAttr_Sampler), overrideParam->GetAttribute(XAttr_NameUID, 0u),
+				overrideParam->GetAttribute(XAttr_UID0, 0u), overrideParam->GetAttribute(XAttr_UID1, 0u), overrideParam->GetAttribute(XAttr_UID2, 0u));
+		}
+
+		auto highResResource = mXML->GetChildNode(XTag_HighResolutionResource, node);
+		mContentHighResolutionResource = (highResResource ? highResResource->GetAttribute(XAttr_Name) : 0);
+	}
+
+	void ReadTextureSetContent(const TCDatabaseStage::TextureSet& stageTextureSet)
+	{
+		mContentName = mStage->GetString(stageTextureSet.mName);
+		mContentColourTints.clear();
+		mContentOverrideParams.clear();
+
+		for (u32 i = 0; stageTextureSet.mColourTints.mCount > i; ++i)
+		{
+			auto& stageTint = mStage->mColourTints[stageTextureSet.mColourTints.mFirst + i];
+			mContentColourTints.push_back({});
+			BuildColourTint(&mContentColourTints.back(), stageTint.r, stageTint.g, stageTint.b);
+		}
+
+		for (u32 i = 0; stageTextureSet.mOverrideParams.mCount > i; ++i)
+		{
+			auto& stageParam = mStage->mOverrideParams[stageTextureSet.mOverrideParams.mFirst + i];
+			mContentOverrideParams.push_back({});
+			BuildTextureOverrideParam(&mContentOverrideParams.back(), mStage->GetString(stageParam.mSampler), stageParam.mNameUID, stageParam.mUID[0], stageParam.mUID[1], stageParam.mUID[2]);
+		}
+
+		const bool hasHighResResource = (stageTextureSet.mHighResolutionResource != TCDatabaseStage::InvalidString);
+		mContentHighResolutionResource = (hasHighResResource ? mStage->GetString(stageTextureSet.mHighResolutionResource) : 0);
+	}
+
+	template <typename T>
+	static u32 InsertContent(TCDedupTable& table, const TCArenaVector<T>& content, u32& numUnique)
+	{
+		if (content.empty()) {
+			return TCDedupTable::InvalidIndex;
+		}
+
+		bool isNew;
+		const u32 index = table.Insert(content.data(), static_cast<u32>(content.size() * sizeof(T)), isNew);
+		if (isNew) {
+			numUnique += static_cast<u32>(content.size());
+		}
+
+		return index;
+	}
+
+	template <typename T>
+	static u32 FindContent(const TCDedupTable& table, const TCArenaVector<T>& content) { return (content.empty() ? TCDedupTable::InvalidIndex : table.Find(content.data(), static_cast<u32>(content.size() * sizeof(T)))); }
+
+	/* The arrays are part of the key through their table entries, so equal entries mean equal content. */
+	void BuildTextureSetKey(int type, u32 colourTints, u32 overrideParams)
+	{
+		auto Append = [this](const void* data, size_t size)
+		{
+			auto bytes = static_cast<const u8*>(data);
+			mContentKey.insert(mContentKey.end(), bytes, bytes + size);
+		};
+
+		mContentKey.clear();
+		Append(&type, sizeof(type));
+		Append(&colourTints, sizeof(colourTints));
+		Append(&overrideParams, sizeof(overrideParams));
+		Append(mContentName, qStringLength(mContentName) + 1);
+
+		if (mContentHighResolutionResource) {
+			Append(mContentHighResolutionResource, qStringLength(mContentHighResolutionResource) + 1);
+		}
+	}
+
+	/* Counts the texture set read into mContent*, returns 0 if it is shared with an earlier one. */
+	bool CountTextureSetContent(int type, SchemaCounts& counts)
+	{
+		const u32 colourTints = InsertContent(mColourTintTable, mContentColourTints, counts.mNumColourTints);
+		const u32 overrideParams = InsertContent(mOverrideParamTable, mContentOverrideParams, counts.mNumTextureOverrideParams);
+		BuildTextureSetKey(type, colourTints, overrideParams);
+
+		bool isNew;
+		mTextureSetTable.Insert(mContentKey.data(), static_cast<u32>(mContentKey.size()), isNew);
+		if (isNew) {
+			++counts.mNumTextureSets;
+		}
+
+		return isNew;
+	}
+
+	template <typename T>
+	T* BuildSharedArray(TCDedupTable::Entry& entry, const TCArenaVector<T>& content, T*& cursor, u32& numShared)
+	{
+		if (entry.mShared)
+		{
+			++numShared;
+			return static_cast<T*>(entry.mShared);
+		}
+
+		qMemCopy(cursor, content.data(), static_cast<u32>(content.size() * sizeof(T)));
+		entry.mShared = cursor;
+		cursor += content.size();
+		return static_cast<T*>(entry.mShared);
+	}
+
+	/* Builds the texture set read into mContent*, or returns the identical one built before. */
+	TrueCrowdTextureSet* BuildSharedTextureSet(int type)
+	{
+		++mNumTextureSetRefs;
+
+		const u32 colourTints = FindContent(mColourTintTable, mContentColourTints);
+		const u32 overrideParams = FindContent(mOverrideParamTable, mContentOverrideParams);
+		BuildTextureSetKey(type, colourTints, overrideParams);
+
+		auto& entry = mTextureSetTable.mEntries[mTextureSetTable.Find(mContentKey.data(), static_cast<u32>(mContentKey.size()))];
+		if (entry.mShared)
+		{
+			++mNumSharedTextureSets;
+			return static_cast<TrueCrowdTextureSet*>(entry.mShared);
+		}
+
+		auto textureSet = mTextureSet++;
+		entry.mShared = textureSet;
+
+		BuildResource(textureSet, mContentName, type);
+		RegisterCrowdResource(textureSet, 1);
+
+		if (colourTints != TCDedupTable::InvalidIndex)
+		{
+			textureSet->mColourTints.Set(BuildSharedArray(mColourTintTable.mEntries[colourTints], mContentColourTints, mColourTints, mNumSharedColourTints));
+			textureSet->mNumColorTints = static_cast<u32>(mContentColourTints.size());
+		}
+
+		if (overrideParams != TCDedupTable::InvalidIndex)
+		{
+			textureSet->mTextureOverrideParams.Set(BuildSharedArray(mOverrideParamTable.mEntries[overrideParams], mContentOverrideParams, mTextureOverrideParams, mNumSharedOverrideParams));
+			textureSet->mNumTextureOverrideParams = static_cast<u32>(mContentOverrideParams.size());
+		}
+
+		if (mContentHighResolutionResource) {
+			mTrueCrowdResourceOffsetFixes.push_back({ &textureSet->mHighResolutionResource, mContentHighResolutionResource, 1 });
+		}
+
+		return textureSet;
+	}
+
+	//------------------------------------
+	//	Build (Stage)
+	//------------------------------------
+
+	void BuildLODModel(TrueCrowdLOD* lod, const TCDatabaseStage::LOD& stageLOD)
+	{
+		if (!stageLOD.mModelParts.mCount) {
+			return;
+		}
+
+		lod->mModelParts.Set(mModelPart);
+
+		for (u32 i = 0; stageLOD.mModelParts.mCount > i; ++i)
+		{
+			auto& stageModelPart = mStage->mModelParts[stageLOD.mModelParts.mFirst + i];
+			BuildModelPart(mModelPart++, mStage->GetString(stageModelPart.mName), stageModelPart.mIsSkinned, stageModelPart.mMorphType);
+			++lod->mNumModelParts;
+		}
+	}
+
+	void BuildTextureSet(TrueCrowdTextureSet* textureSet, int type, const TCDatabaseStage::TextureSet& stageTextureSet)
+	{
+		BuildResource(textureSet, mStage->GetString(stageTextureSet.mName), type);
+		RegisterCrowdResource(textureSet, 1);
+
+		if (stageTextureSet.mColourTints.mCount)
+		{
+			textureSet->mColourTints.Set(mColourTints);
+
+			for (u32 i = 0; stageTextureSet.mColourTints.mCount > i; ++i)
+			{
+				auto& stageTint = mStage->mColourTints[stageTextureSet.mColourTints.mFirst + i];
+				BuildColourTint(mColourTints++, stageTint.r, stageTint.g, stageTint.b);
+				++textureSet->mNumColorTints;
+			}
+		}
+
+		if (stageTextureSet.mOverrideParams.mCount)
+		{
+			textureSet->mTextureOverrideParams.Set(mTextureOverrideParams);
+
+			for (u32 i = 0; stageTextureSet.mOverrideParams.mCount > i; ++i)
+			{
+				auto& stageParam = mStage->mOverrideParams[stageTextureSet.mOverrideParams.mFirst + i];
+				BuildTextureOverrideParam(mTextureOverrideParams++, mStage->GetString(stageParam.mSampler), stageParam.mNameUID, stageParam.mUID[0], stageParam.mUID[1], stageParam.mUID[2]);
+				++textureSet->mNumTextureOverrideParams;
+			}
+		}
+
+		if (stageTextureSet.mHighResolutionResource != TCDatabaseStage::InvalidString) {
+			mTrueCrowdResourceOffsetFixes.push_back({ &textureSet->mHighResolutionResource, mStage->GetString(stageTextureSet.mHighResolutionResource), 1 });
+		}
+	}
+
+	void BuildResourceEntry(TrueCrowdDataBase::ResourceEntry* entry, const TCDatabaseStage::Resource& stageResource)
+	{
+		auto model = &entry->mResource;
+		const char* name = mStage->GetString(stageResource.mName);
+		int type = stageResource.mType;
+
+		if (type == TrueCrowdResource::Invalid)	{
+			Report("WARN: Resource %s has an invalid type specified.\n", name);
+		}
+
+		for (u32 i = 0; stageResource.mTags.mCount > i; ++i) {
+			BuildTagBit(&entry->mTagBitFlag, name, mStage->GetString(mStage->mResourceTags[stageResource.mTags.mFirst + i]));
+		}
+
+		BuildResource(model, name, type);
+		RegisterCrowdResource(model, 0);
+
+		model->mComponentTypeSymbolUC = mComponentTypeSymbolUC;
+
+		if (stageResource.mHighResolutionResource != TCDatabaseStage::InvalidString) {
+			mTrueCrowdResourceOffsetFixes.push_back({ &model->mHighResolutionResource, mStage->GetString(stageResource.mHighResolutionResource), 0 });
+		}
+
+		if (stageResource.mLODs.mCount)
+		{
+			model->mLODModel.Set(mLOD);
+
+			for (u32 i = 0; stageResource.mLODs.mCount > i; ++i)
+			{
+				BuildLODModel(mLOD++, mStage->mLODs[stageResource.mLODs.mFirst + i]);
+				++model->mNumLODs;
+			}
+		}
+
+		if (stageResource.mTextureSets.mCount)
+		{
+			model->mTextureSets.Set(mTextureSetArray);
+
+			for (u32 i = 0; stageResource.mTextureSets.mCount > i; ++i)
+			{
+				auto& stageTextureSet = mStage->mTextureSets[stageResource.mTextureSets.mFirst + i];
+				if (mDedup)
+				{
+					ReadTextureSetContent(stageTextureSet);
+					mTextureSetArray->Set(BuildSharedTextureSet(type));
+				}
+				else
+				{
+					BuildTextureSet(mTextureSet, type, stageTextureSet);
+					mTextureSetArray->Set(mTextureSet++);
+				}
+
+				++mTextureSetArray;
+
+				++model->mNumTextureSets;
+			}
+		}
+	}
+
+	void BuildComponent(TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, const TCDatabaseStage::Component& stageComponent)
+	{
+		BuildComponentName(component, mStage->GetString(stageComponent.mName));
+
+		if (!stageComponent.mResources.mCount) {
+			return;
+		}
+
+		entry->mEntries.Set(mResourceEntry);
+
+		for (u32 i = 0; stageComponent.mResources.mCount > i; ++i)
+		{
+			BuildResourceEntry(mResourceEntry++, mStage->mResources[stageComponent.mResources.mFirst + i]);
+			++entry->mNumEntries;
+		}
+	}
+
+	void BuildEntity(TrueCrowdDefinition::Entity* entity, const TCDatabaseStage::Entity& stageEntity)
+	{
+		entity->mNameUID = CreateSymbol(mStage->GetString(stageEntity.mName), 1);
+
+		for (u32 i = 0; stageEntity.mComponents.mCount > i; ++i)
+		{
+			auto& stageComponent = mStage->mEntityComponents[stageEntity.mComponents.mFirst + i];
+
+			auto entitycomponent = &entity->mComponents[entity->mComponentCount++];
+			entitycomponent->mName = CreateSymbol(mStage->GetString(stageComponent.mName), 0);
+			entitycomponent->mResourceIndex = stageComponent.mResourceIndex;
+			entitycomponent->mbRequired = stageComponent.mRequired;
+
+			for (u32 j = 0; stageComponent.mBoneUIDs.mCount > j; ++j) {
+				entitycomponent->mBoneUID[entitycomponent->mNumBoneUIDs++] = CreateSymbol(mStage->GetString(mStage->mBoneUIDs[stageComponent.mBoneUIDs.mFirst + j]), 1);
+			}
+
+			if (entitycomponent->mbRequired) {
+				++entity->mRequiredComponentCount;
+			}
+		}
+	}
+
+	template <typename Layout>
+	bool BuildStagedSchema()
+	{
+		if (!mStage->mHasTCDB)
+		{
+			qPrintf("ERROR: Required XML tag <%s> is missing.\n", XTag_TCDB);
+			return 0;
+		}
+
+		if (!mStage->mHasDefinition)
+		{
+			qPrintf("ERROR: Required XML tag <%s> is missing inside <%s>.\n", XTag_Definition, XTag_TCDB);
+			return 0;
+		}
+
+		if (!mStage->mHasComponentEntries)
+		{
+			qPrintf("ERROR: Required XML tag <%s> is missing inside <%s>.\n", XTag_ComponentEntries, XTag_TCDB);
+			return 0;
+		}
+
+		auto start = TCStats::Clock::now();
+
+		SchemaCounts counts;
+		counts.mNumTags = mStage->mNumTagsChildren;
+		counts.mNumComponentEntries = mStage->mNumComponentEntriesChildren;
+		counts.mNumResourceEntries = mStage->mNumResourceEntries;
+		counts.mNumLODs = static_cast<u32>(mStage->mLODs.size());
+		counts.mNumModelParts = static_cast<u32>(mStage->mModelParts.size());
+		counts.mNumTextureSetOffsets = counts.mNumTextureSets = static_cast<u32>(mStage->mTextureSets.size());
+		counts.mNumColourTints = static_cast<u32>(mStage->mColourTints.size());
+		counts.mNumTextureOverrideParams = static_cast<u32>(mStage->mOverrideParams.size());
+		counts.mStringBufferSize = mStage->mStringBufferSize;
+
+		if (mPoolStrings || mDedup)
+		{
+			if (mPoolStrings) {
+				mStringPool.reserve(mStage->mResources.size() + mStage->mModelParts.size() + mStage->mTextureSets.size());
+			}
+
+			counts.mStringBufferSize = 0;
+
+			for (auto& resource : mStage->mResources) {
+				counts.mStringBufferSize += CountBufferString(mStage->GetString(resource.mName));
+			}
+
+			for (auto& modelPart : mStage->mModelParts) {
+				counts.mStringBufferSize += CountBufferString(mStage->GetString(modelPart.mName));
+			}
+
+			if (mDedup)
+			{
+				counts.mNumTextureSets = counts.mNumColourTints = counts.mNumTextureOverrideParams = 0;
+
+				for (auto& resource : mStage->mResources)
+				{
+					for (u32 i = 0; resource.mTextureSets.mCount > i; ++i)
+					{
+						ReadTextureSetContent(mStage->mTextureSets[resource.mTextureSets.mFirst + i]);
+						if (CountTextureSetContent(resource.mType, counts)) {
+							counts.mStringBufferSize += CountBufferString(mContentName);
+						}
+					}
+				}
+			}
+			else
+			{
+				for (auto& textureSet : mStage->mTextureSets) {
+					counts.mStringBufferSize += CountBufferString(mStage->GetString(textureSet.mName));
+				}
+			}
+		}
+
+		if (CanBuildParallel())
+		{
+			SchemaCounts componentCounts;
+			mComponentCounts.reserve(mStage->mComponents.size() + 1);
+
+			for (auto& stageComponent : mStage->mComponents)
+			{
+				mComponentCounts.push_back(componentCounts);
+				CountStagedComponent(stageComponent, componentCounts);
+			}
+
+			mComponentCounts.push_back(componentCounts);
+		}
+
+		if (mStats) {
+			mStats->AddPhase("schema_count", start);
+		}
+
+		return AllocateSchema<Layout>(counts);
+	}
+
+	/* Same build order as the XMLDocument path, so string buffer, fixups and symbols come out identical. */
+	template <typename Layout>
+	bool BuildStaged()
+	{
+		if (!BuildStagedSchema<Layout>()) {
+			return 0;
+		}
+
+		BuildResource();
+
+		auto definition = &mDB->mDefinition;
+		auto components = TCDatabaseLayout<Layout>::GetComponents(mDB);
+		auto entityBlock = TCDatabaseLayout<Layout>::GetEntityBlock(mDB);
+		auto tagBlock = TCDatabaseLayout<Layout>::GetTagBlock(mDB);
+		auto componentEntryBlock = TCDatabaseLayout<Layout>::GetComponentEntryBlock(mDB);
+
+		{
+			TCStats::ScopedPhase phase(mStats, "build_entities");
+
+			for (auto& stageEntity : mStage->mEntities) {
+				BuildEntity(&entityBlock->mEntities[entityBlock->mEntityCount++], stageEntity);
+			}
+		}
+
+		{
+			TCStats::ScopedPhase phase(mStats, "build_tags");
+
+			auto tagList = tagBlock->mTagList.Get();
+			for (auto tag : mStage->mTags) {
+				tagList[tagBlock->mNumTags++] = CreateTagSymbol(mStage->GetString(tag));
+			}
+
+			BuildTagIndex(tagList, tagBlock->mNumTags);
+		}
+
+		if (mCache) {
+			BeginIncremental();
+		}
+
+		{
+			TCStats::ScopedPhase phase(mStats, "build_components");
+
+			auto componentEntries = componentEntryBlock->mComponentEntries.Get();
+			if (CanBuildParallel())
+			{
+				const u32 count = static_cast<u32>(mStage->mComponents.size());
+				BuildComponentsParallel(components, componentEntries, count, [this](TCDatabaseScriber& worker, TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, u32 i)
+				{
+					worker.BuildComponent(component, entry, mStage->mComponents[i]);
+				});
+
+				definition->mComponentCount += count;
+				componentEntryBlock->mNumComponentEntries += count;
+			}
+			else
+			{
+				for (auto& stageComponent : mStage->mComponents)
+				{
+					auto component = &components[definition->mComponentCount++];
+					auto entry = &componentEntries[componentEntryBlock->mNumComponentEntries++];
+
+					if (mCache) {
+						BuildComponentIncremental(component, entry, stageComponent);
+					}
+					else {
+						BuildComponent(component, entry, stageComponent);
+					}
+				}
+			}
+		}
+
+		if (mCache) {
+			qPrintf("Incremental build reused %u of %u component(s).\n", mNumReusedComponents, static_cast<u32>(mStage->mComponents.size()));
+		}
+
+		return ResolveResourceOffsetFixes();
+	}
+
+	//------------------------------------
+	//	Build (Parallel)
+	//------------------------------------
+
+	/* Pooling and dedup share content across components and incremental builds relink cached slices, these stay serial. */
+	bool CanBuildParallel() const { return mPool && !mPoolStrings && !mDedup && !mCache; }
+
+	/* Records where the next component starts, numResources counts <Resource> nodes as the build advances by those only. */
+	void AddComponentCounts(const SchemaCounts& counts, u32 numResources)
+	{
+		mComponentCounts.push_back(counts);
+		mComponentCounts.back().mNumResourceEntries = numResources;
+	}
+
+	void CountStagedComponent(const TCDatabaseStage::Component& stageComponent, SchemaCounts& counts)
+	{
+		counts.mNumResourceEntries += stageComponent.mResources.mCount;
+
+		for (u32 i = 0; stageComponent.mResources.mCount > i; ++i)
+		{
+			auto& stageResource = mStage->mResources[stageComponent.mResources.mFirst + i];
+			counts.mStringBufferSize += static_cast<u32>(qStringLength(mStage->GetString(stageResource.mName))) + 1;
+			counts.mNumLODs += stageResource.mLODs.mCount;
+
+			for (u32 j = 0; stageResource.mLODs.mCount > j; ++j)
+			{
+				auto& stageLOD = mStage->mLODs[stageResource.mLODs.mFirst + j];
+				counts.mNumModelParts += stageLOD.mModelParts.mCount;
+
+				for (u32 k = 0; stageLOD.mModelParts.mCount > k; ++k) {
+					counts.mStringBufferSize += static_cast<u32>(qStringLength(mStage->GetString(mStage->mModelParts[stageLOD.mModelParts.mFirst + k].mName))) + 1;
+				}
+			}
+
+			counts.mNumTextureSetOffsets += stageResource.mTextureSets.mCount;
+			counts.mNumTextureSets += stageResource.mTextureSets.mCount;
+
+			for (u32 j = 0; stageResource.mTextureSets.mCount > j; ++j)
+			{
+				auto& stageTextureSet = mStage->mTextureSets[stageResource.mTextureSets.mFirst + j];
+				counts.mStringBufferSize += static_cast<u32>(qStringLength(mStage->GetString(stageTextureSet.mName))) + 1;
+				counts.mNumColourTints += stageTextureSet.mColourTints.mCount;
+				counts.mNumTextureOverrideParams += stageTextureSet.mOverrideParams.mCount;
+			}
+		}
+	}
+
+	void AdvanceCursors(const SchemaCounts& counts)
+	{
+		mResourceEntry += counts.mNumResourceEntries;
+		mLOD += counts.mNumLODs;
+		mModelPart += counts.mNumModelParts;
+		mTextureSetArray += counts.mNumTextureSetOffsets;
+		mTextureSet += counts.mNumTextureSets;
+		mColourTints += counts.mNumColourTints;
+		mTextureOverrideParams += counts.mNumTextureOverrideParams;
+		mStrLen += counts.mStringBufferSize;
+	}
+
+	/*
+	*	Takes over what a worker collected, merged in component order this matches the serial build. The log is printed up
+	*	to each deferred registration, so duplicate name warnings come out between the other warnings as they would serially.
+	*/
+	void MergeWorker(TCDatabaseScriber& worker)
+	{
+		size_t logOffset = 0;
+
+		for (auto& registered : worker.mRegisteredResources)
+		{
+			if (registered.mLogOffset > logOffset)
+			{
+				qPrintf("%s", worker.mLog.substr(logOffset, registered.mLogOffset - logOffset).c_str());
+				logOffset = registered.mLogOffset;
+			}
+
+			RegisterCrowdResource(registered.mResource, registered.mIsTextureSet);
+		}
+
+		if (worker.mLog.size() > logOffset) {
+			qPrintf("%s", worker.mLog.c_str() + logOffset);
+		}
+
+		mSymbols.insert(mSymbols.end(), worker.mSymbols.begin(), worker.mSymbols.end());
+		mTrueCrowdResourceOffsetFixes.insert(mTrueCrowdResourceOffsetFixes.end(), worker.mTrueCrowdResourceOffsetFixes.begin(), worker.mTrueCrowdResourceOffsetFixes.end());
+		mNumUnknownTags += worker.mNumUnknownTags;
+	}
+
+	/* buildComponent(worker, component, entry, index) runs on mPool, every worker only writes the slots reserved by its counts. */
+	template <typename Fn>
+	void BuildComponentsParallel(TrueCrowdDefinition::Component* components, TrueCrowdDataBase::ComponentEntries* componentEntries, u32 count, Fn buildComponent)
+	{
+		std::vector<std::unique_ptr<TCDatabaseScriber>> workers;
+		workers.reserve(count);
+
+		for (u32 i = 0; count > i; ++i) {
+			workers.emplace_back(new TCDatabaseScriber(*this, i));
+		}
+
+		mPool->ParallelFor(count, [&](u32 i) { buildComponent(*workers[i], &components[i], &componentEntries[i], i); });
+
+		for (auto& worker : workers) {
+			MergeWorker(*worker);
+		}
+
+		AdvanceCursors(mComponentCounts[count]);
+	}
+
+	//------------------------------------
+	//	Build (Incremental)
+	//------------------------------------
+
+	void BeginIncremental()
+	{
+		mCacheKey = TCDatabaseCache::HashKey(*mStage, mVersion);
+
+		if (!mCache->mComponents.empty() && mCache->mKey != mCacheKey)
+		{
+			qPrintf("Tag list or layout changed since the incremental cache was written, rebuilding every component.\n");
+			mCache->mComponentIndex.clear();
+		}
+
+		mCacheComponents.reserve(mStage->mComponents.size());
+	}
+
+	void GetSliceCursors(u8* cursors[TCDatabaseCache::NUM_SLICES])
+	{
+		cursors[TCDatabaseCache::SLICE_RESOURCE_ENTRIES] = reinterpret_cast<u8*>(mResourceEntry);
+		cursors[TCDatabaseCache::SLICE_LODS] = reinterpret_cast<u8*>(mLOD);
+		cursors[TCDatabaseCache::SLICE_MODEL_PARTS] = reinterpret_cast<u8*>(mModelPart);
+		cursors[TCDatabaseCache::SLICE_TEXTURE_SET_ARRAY] = reinterpret_cast<u8*>(mTextureSetArray);
+		cursors[TCDatabaseCache::SLICE_TEXTURE_SETS] = reinterpret_cast<u8*>(mTextureSet);
+		cursors[TCDatabaseCache::SLICE_COLOUR_TINTS] = reinterpret_cast<u8*>(mColourTints);
+		cursors[TCDatabaseCache::SLICE_TEXTURE_OVERRIDE_PARAMS] = reinterpret_cast<u8*>(mTextureOverrideParams);
+		cursors[TCDatabaseCache::SLICE_STRINGS] = reinterpret_cast<u8*>(&mStrBuffer[mStrLen]);
+	}
+
+	template <typename T>
+	void Relink(qOffset64<T>& offset, s64 selfDelta, s64 targetDelta)
+	{
+		if (auto target = offset.Get()) {
+			offset.Set((T)((const u8*)target - selfDelta + targetDelta));
+		}
+	}
+
+	/* Copies the slices of a cached component to the current cursors and relinks them, registers resources and fixups in build order. */
+	void ReuseComponent(TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, const TCDatabaseStage::Component& stageComponent, const TCDatabaseCache::Component& cached)
+	{
+		BuildComponentName(component, mStage->GetString(stageComponent.mName));
+
+		u8* cursors[TCDatabaseCache::NUM_SLICES];
+		GetSliceCursors(cursors);
+
+		s64 delta[TCDatabaseCache::NUM_SLICES];
+		for (u32 i = 0; TCDatabaseCache::NUM_SLICES > i; ++i)
+		{
+			qMemCopy(cursors[i], cached.mSliceData[i], cached.mSliceSize[i]);
+			delta[i] = static_cast<s64>(cursors[i] - reinterpret_cast<u8*>(mDB)) - static_cast<s64>(cached.mSliceOffset[i]);
+		}
+
+		const u32 numResourceEntries = cached.mSliceSize[TCDatabaseCache::SLICE_RESOURCE_ENTRIES] / sizeof(TrueCrowdDataBase::ResourceEntry);
+		const u32 numLODs = cached.mSliceSize[TCDatabaseCache::SLICE_LODS] / sizeof(TrueCrowdLOD);
+		const u32 numModelParts = cached.mSliceSize[TCDatabaseCache::SLICE_MODEL_PARTS] / sizeof(TrueCrowdModelPart);
+		const u32 numTextureSets = cached.mSliceSize[TCDatabaseCache::SLICE_TEXTURE_SETS] / sizeof(TrueCrowdTextureSet);
+
+		const s64 entryDelta = delta[TCDatabaseCache::SLICE_RESOURCE_ENTRIES];
+		const s64 textureSetDelta = delta[TCDatabaseCache::SLICE_TEXTURE_SETS];
+		const s64 stringDelta = delta[TCDatabaseCache::SLICE_STRINGS];
+
+		auto textureSet = mTextureSet;
+
+		for (u32 i = 0; numResourceEntries > i; ++i)
+		{
+			auto model = &mResourceEntry[i].mResource;
+			Relink(model->mName, entryDelta, stringDelta);
+			Relink(model->mLODModel, entryDelta, delta[TCDatabaseCache::SLICE_LODS]);
+			Relink(model->mTextureSets, entryDelta, delta[TCDatabaseCache::SLICE_TEXTURE_SET_ARRAY]);
+			RegisterCrowdResource(model, 0);
+
+			for (u32 j = 0; model->mNumTextureSets > j; ++j, ++textureSet)
+			{
+				Relink(textureSet->mName, textureSetDelta, stringDelta);
+				Relink(textureSet->mColourTints, textureSetDelta, delta[TCDatabaseCache::SLICE_COLOUR_TINTS]);
+				Relink(textureSet->mTextureOverrideParams, textureSetDelta, delta[TCDatabaseCache::SLICE_TEXTURE_OVERRIDE_PARAMS]);
+				RegisterCrowdResource(textureSet, 1);
+			}
+		}
+
+		for (u32 i = 0; numLODs > i; ++i) {
+			Relink(mLOD[i].mModelParts, delta[TCDatabaseCache::SLICE_LODS], delta[TCDatabaseCache::SLICE_MODEL_PARTS]);
+		}
+
+		for (u32 i = 0; numModelParts > i; ++i) {
+			Relink(mModelPart[i].mModelName, delta[TCDatabaseCache::SLICE_MODEL_PARTS], stringDelta);
+		}
+
+		for (u32 i = 0; numTextureSets > i; ++i) {
+			Relink(mTextureSetArray[i], delta[TCDatabaseCache::SLICE_TEXTURE_SET_ARRAY], textureSetDelta);
+		}
+
+		for (auto& fixup : cached.mFixups)
+		{
+			auto owner = cursors[fixup.mIsTextureSet ? TCDatabaseCache::SLICE_TEXTURE_SETS : TCDatabaseCache::SLICE_RESOURCE_ENTRIES];
+			mTrueCrowdResourceOffsetFixes.push_back({ reinterpret_cast<qOffset64<TrueCrowdResource*>*>(owner + fixup.mOffset), fixup.mName, fixup.mIsTextureSet != 0 });
+		}
+
+		for (auto& symbol : cached.mSymbols) {
+			mSymbols.push_back({ symbol.mUID, symbol.mStr });
+		}
+
+		if (numResourceEntries)
+		{
+			entry->mEntries.Set(mResourceEntry);
+			entry->mNumEntries = numResourceEntries;
+		}
+
+		mResourceEntry += numResourceEntries;
+		mLOD += numLODs;
+		mModelPart += numModelParts;
+		mTextureSetArray += numTextureSets;
+		mTextureSet += numTextureSets;
+		mColourTints += cached.mSliceSize[TCDatabaseCache::SLICE_COLOUR_TINTS] / sizeof(qColour);
+		mTextureOverrideParams += cached.mSliceSize[TCDatabaseCache::SLICE_TEXTURE_OVERRIDE_PARAMS] / sizeof(TextureOverrideParams);
+		mStrLen += cached.mSliceSize[TCDatabaseCache::SLICE_STRINGS];
+		mNumUnknownTags += cached.mNumUnknownTags;
+	}
+
+	void BuildComponentIncremental(TrueCrowdDefinition::Component* component, TrueCrowdDataBase::ComponentEntries* entry, const TCDatabaseStage::Component& stageComponent)
+	{
+		TCDatabaseCache::Component record;
+		record.mHash = TCDatabaseCache::HashComponent(*mStage, stageComponent);
+
+		u8* begin[TCDatabaseCache::NUM_SLICES];
+		GetSliceCursors(begin);
+
+		const size_t firstFixup = mTrueCrowdResourceOffsetFixes.size();
+		const u32 numUnknownTags = mNumUnknownTags;
+
+		if (auto cached = mCache->Find(record.mHash))
+		{
+			ReuseComponent(component, entry, stageComponent, *cached);
+			record.mSymbols = cached->mSymbols;
+			++mNumReusedComponents;
+		}
+		else
+		{
+			mRecordSymbols = &record.mSymbols;
+			BuildComponent(component, entry, stageComponent);
+			mRecordSymbols = 0;
+		}
+
+		u8* end[TCDatabaseCache::NUM_SLICES];
+		GetSliceCursors(end);
+
+		for (u32 i = 0; TCDatabaseCache::NUM_SLICES > i; ++i)
+		{
+			record.mSliceOffset[i] = static_cast<u64>(begin[i] - reinterpret_cast<u8*>(mDB));
+			record.mSliceSize[i] = static_cast<u32>(end[i] - begin[i]);
+			record.mSliceData[i] = begin[i];
+		}
+
+		for (size_t i = firstFixup; mTrueCrowdResourceOffsetFixes.size() > i; ++i)
+		{
+			auto& fix = mTrueCrowdResourceOffsetFixes[i];
+			auto owner = begin[fix.mIsTextureSet ? TCDatabaseCache::SLICE_TEXTURE_SETS : TCDatabaseCache::SLICE_RESOURCE_ENTRIES];
+			record.mFixups.push_back({ static_cast<u32>(reinterpret_cast<u8*>(fix.mOffset) - owner), fix.mIsTextureSet, fix.mName });
+		}
+
+		record.mNumUnknownTags = mNumUnknownTags - numUnknownTags;
+		mCacheComponents.push_back(std::move(record));
+	}
+
+	/* Call after Export, symbols of reused components point into the previous cache until then. */
+	bool SaveCache(const char* filename) { return mCache->Save(filename, mCacheKey, mCacheComponents); }
+
+	void AddStats(TCStats& stats)
+	{
+		stats.SetCounter("schema_bytes", mByteSize);
+		stats.SetCounter("string_buffer_bytes", mStrLen);
+
+		if (mPoolStrings) {
+			stats.SetCounter("string_pool_saved_bytes", mUnpooledStringBufferSize - mStrLen);
+		}
+
+		if (mDedup)
+		{
+			stats.SetCounter("shared_texture_sets", mNumSharedTextureSets);
+			stats.SetCounter("shared_colour_tint_arrays", mNumSharedColourTints);
+			stats.SetCounter("shared_override_param_arrays", mNumSharedOverrideParams);
+		}
+		stats.SetCounter("symbols", mSymbols.size());
+		stats.SetCounter("offset_fixups", mTrueCrowdResourceOffsetFixes.size());
+		stats.SetCounter("unknown_tags", mNumUnknownTags);
+
+		if (mCache) {
+			stats.SetCounter("reused_components", mNumReusedComponents);
+		}
+
+		if (mArena)
+		{
+			stats.SetCounter("arena_bytes", mArena->mBytesUsed);
+			stats.SetCounter("arena_blocks", mArena->mNumBlocks);
+		}
+	}
+
+	/* filename - writes the chunk to the output stream. The symbols go to <filename>_qsymbols.txt unless qSymbolsFilename is given, an empty one skips them. */
+	void Export(const char* filename, const char* qSymbolsFilename = 0)
+	{
+		qString defaultQSymbolsFilename = filename;
+		if (!qSymbolsFilename)
+		{
+			defaultQSymbolsFilename = defaultQSymbolsFilename.GetFilePathWithoutExtension() + "_qsymbols.txt";
+			qSymbolsFilename = defaultQSymbolsFilename;
+		}
+
+		auto start = TCStats::Clock::now();
+
+		if (auto f = (*qSymbolsFilename ? qOpen(qSymbolsFilename, QACCESS_WRITE) : 0))
+		{
+			qString buf;
+
+			for (auto& sym : mSymbols)
+			{
+				buf.Format("0x%08X %s\n", sym.mUID, sym.mStr);
+				qWriteString(f, buf, buf.Length());
+			}
+
+			qClose(f);
+			qPrintf("QSymbols has been exported to: %s\n", qSymbolsFilename);
+		}
+
+		if (mStats)
+		{
+			mStats->AddPhase("qsymbols_dump", start);
+			start = TCStats::Clock::now();
+		}
+
+		if (IsStdStream(filename))
+		{
+			/* The builder only writes files, the stream gets a copy of its output. */
+			const std::string chunkFilename = GetTempFilename(".bin");
+			WriteChunkFile(chunkFilename.c_str());
+
+			if (!CopyFileToStream(chunkFilename.c_str(), GetOutputStream())) {
+				qPrintf("ERROR: Failed to copy %s to the output stream.\n", chunkFilename.c_str());
+			}
+
+			std::error_code ec;
+			std::filesystem::remove(chunkFilename, ec);
+		}
+		else
+		{
+			WriteChunkFile(filename);
+		}
+
+		if (mStats) {
+			mStats->AddPhase("chunk_write", start);
+		}
 
 		qPrintf("File has been exported to: %s\n", filename);
 	}
+
+	/* Lets the next scriber allocate the schema, call once the chunk is written or copied out. mDB is gone afterwards. */
+	void ReleaseSchema()
+	{
+		if (mSchemaLock.owns_lock()) {
+			mSchemaLock.unlock();
+		}
+
+		mDB = 0;
+	}
+
+	void WriteChunkFile(const char* filename)
+	{
+		qChunkFileBuilder chunkBuilder;
+		chunkBuilder.CreateBuilder("PC64", filename, 0, 0);
+
+		chunkBuilder.BeginChunk(ChunkUID_TrueCrowdDataBase, "TrueCrowdDB", 1);
+		chunkBuilder.Write(mDB, mByteSize);
+		chunkBuilder.EndChunk(ChunkUID_TrueCrowdDataBase);
+
+		chunkBuilder.CloseBuilder(0, true);
+	}
+
+	/* Reads back the bytes of Export, qChunkFileBuilder lays them out in a temporary file so the header and padding are the engine's. */
+	bool ExportChunk(std::vector<u8>& data)
+	{
+		const std::string chunkFilename = GetTempFilename(".bin");
+		WriteChunkFile(chunkFilename.c_str());
+
+		const bool result = ReadEntireFile(chunkFilename.c_str(), data);
+
+		std::error_code ec;
+		std::filesystem::remove(chunkFilename, ec);
+		return result;
+	}
 };
\ No newline at end of file
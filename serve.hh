@@ -0,0 +1,486 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "query.hh"
+#include "threadpool.hh"
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Resident server (-serve) and its client (-client).
+///
+///		The server keeps the symbol tables loaded and the thread pool running, so a job only
+///		pays for itself. Requests are one job per line, read from stdin (-serve -) or from the
+///		connections of a Unix domain socket (-serve <path>):
+///
+///		- conv <file>, scribe <file>, verify <file>:	same as the command line jobs,
+///		- query <file> <query>[;<query>...]:			see TCDatabaseQuery,
+///		- shutdown:										stop once the running jobs are done.
+///
+///		Files are opened relative to the server's working directory. The jobs of a connection
+///		run concurrently on the pool and the options given to -serve apply to all of them. Every
+///		job is answered in one piece and numbered by its line on the connection: "@<n>: <text>"
+///		for each line of query output, then "@<n> ok|fail <ms> ms". On stdin the answers share
+///		stdout with the job messages, so clients only look at lines starting with '@'.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCServer
+{
+public:
+	struct Connection
+	{
+		std::function<bool(std::string&)> mReadLine;
+		std::function<void(const std::string&)> mWrite;
+		std::mutex mWriteMutex;
+	};
+
+	/* mPool must be set, it is shared by all connections. */
+	TCJobOptions mOptions;
+
+	std::mutex mStatsMutex;
+	u32 mNumJobs = 0;
+	u32 mNumFailed = 0;
+	double mTotalMilliseconds = 0.0;
+	double mMaxMilliseconds = 0.0;
+
+	std::atomic<bool> mStop = { 0 };
+	int mListenSocket = -1;
+
+	std::mutex mConnectionMutex;
+	std::condition_variable mConnectionCondition;
+	u32 mNumConnections = 0;
+
+	TCServer(const TCJobOptions& options) : mOptions(options) {}
+
+	static std::string Trim(const std::string& str)
+	{
+		const size_t begin = str.find_first_not_of(" \t\r\n");
+		if (begin == std::string::npos) {
+			return std::string();
+		}
+
+		return str.substr(begin, str.find_last_not_of(" \t\r\n") + 1 - begin);
+	}
+
+	//------------------------------------
+	//	Jobs
+	//------------------------------------
+
+	bool RunJob(const std::string& line, std::string& output)
+	{
+		const size_t commandEnd = line.find_first_of(" \t");
+		const std::string command = line.substr(0, commandEnd);
+		const std::string args = (commandEnd != std::string::npos ? Trim(line.substr(commandEnd)) : std::string());
+
+		if (args.empty())
+		{
+			output += "ERROR: Job " + command + " is missing a file.\n";
+			return 0;
+		}
+
+		if (command == "conv") {
+			return ConvertFile(args.c_str(), mOptions);
+		}
+
+		if (command == "scribe") {
+			return ScribeFile(args.c_str(), mOptions);
+		}
+
+		if (command == "verify") {
+			return VerifyFile(args.c_str(), mOptions);
+		}
+
+		if (command == "query")
+		{
+			const size_t fileEnd = args.find_first_of(" \t");
+			if (fileEnd == std::string::npos)
+			{
+				output += "ERROR: Job query is missing the query.\n";
+				return 0;
+			}
+
+			const std::string queries = Trim(args.substr(fileEnd));
+			return QueryFile(args.substr(0, fileEnd).c_str(), queries.c_str(), mOptions, &output);
+		}
+
+		output += "ERROR: Unknown job " + command + ", expected conv, scribe, verify, query or shutdown.\n";
+		return 0;
+	}
+
+	void Answer(Connection& connection, u32 index, const std::string& line, bool result, double ms, const std::string& output)
+	{
+		char buf[64];
+		std::string answer;
+
+		for (size_t begin = 0; output.size() > begin;)
+		{
+			size_t end = output.find('\n', begin);
+			if (end == std::string::npos) {
+				end = output.size();
+			}
+
+			snprintf(buf, sizeof(buf), "@%u: ", index);
+			answer += buf;
+			answer.append(output, begin, end - begin);
+			answer += '\n';
+
+			begin = end + 1;
+		}
+
+		snprintf(buf, sizeof(buf), "@%u %s %.3f ms\n", index, (result ? "ok" : "fail"), ms);
+		answer += buf;
+
+		{
+			std::lock_guard<std::mutex> lock(connection.mWriteMutex);
+			connection.mWrite(answer);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mStatsMutex);
+
+			++mNumJobs;
+			mNumFailed += !result;
+			mTotalMilliseconds += ms;
+
+			if (ms > mMaxMilliseconds) {
+				mMaxMilliseconds = ms;
+			}
+		}
+
+		qPrintf("[%s] #%u %s (%.3f ms)\n", (result ? " OK " : "FAIL"), index, line.c_str(), ms);
+	}
+
+	/* Runs the jobs of a connection until it ends or asks for shutdown. */
+	void Serve(Connection& connection)
+	{
+		ThreadPool::TaskGroup group;
+		u32 numLines = 0;
+		u32 shutdownIndex = 0;
+
+		for (std::string line; connection.mReadLine(line);)
+		{
+			line = Trim(line);
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+
+			const u32 index = ++numLines;
+
+			if (line == "shutdown")
+			{
+				shutdownIndex = index;
+				break;
+			}
+
+			mOptions.mPool->Submit(group, [this, &connection, index, line]
+			{
+				auto start = TCStats::Clock::now();
+
+				std::string output;
+				const bool result = RunJob(line, output);
+
+				Answer(connection, index, line, result, TCStats::ToMilliseconds(TCStats::Clock::now() - start), output);
+			});
+		}
+
+		mOptions.mPool->Wait(group);
+
+		if (shutdownIndex)
+		{
+			Stop();
+			Answer(connection, shutdownIndex, "shutdown", 1, 0.0, std::string());
+		}
+	}
+
+	void Stop()
+	{
+		mStop = 1;
+
+#ifndef _WIN32
+		if (mListenSocket >= 0) {
+			shutdown(mListenSocket, SHUT_RDWR);
+		}
+#endif
+	}
+
+	void PrintSummary()
+	{
+		const double mean = (mNumJobs ? mTotalMilliseconds / mNumJobs : 0.0);
+		qPrintf("Served %u job(s), %u failed, latency %.3f ms mean, %.3f ms max.\n", mNumJobs, mNumFailed, mean, mMaxMilliseconds);
+	}
+
+	//------------------------------------
+	//	Transport
+	//------------------------------------
+
+	bool RunStdin()
+	{
+		Connection connection;
+		connection.mReadLine = [](std::string& line) { return static_cast<bool>(std::getline(std::cin, line)); };
+		connection.mWrite = [](const std::string& data)
+		{
+			fwrite(data.data(), 1, data.size(), stdout);
+			fflush(stdout);
+		};
+
+		qPrintf("Serving jobs from stdin on %u thread(s).\n", mOptions.mPool->GetNumThreads());
+		fflush(stdout);
+
+		Serve(connection);
+		PrintSummary();
+		return 1;
+	}
+
+#ifndef _WIN32
+	static bool SendAll(int fd, const char* data, size_t size)
+	{
+	#ifdef MSG_NOSIGNAL
+		const int flags = MSG_NOSIGNAL;
+	#else
+		const int flags = 0;
+	#endif
+
+		while (size)
+		{
+			const ssize_t sent = send(fd, data, size, flags);
+			if (sent < 0 && errno == EINTR) {
+				continue;
+			}
+
+			if (sent <= 0) {
+				return 0;
+			}
+
+			data += sent;
+			size -= static_cast<size_t>(sent);
+		}
+
+		return 1;
+	}
+
+	/* Reads the next '\n' terminated line, a last line without one is returned at the end of the stream. */
+	static bool ReceiveLine(int fd, std::string& pending, std::string& line)
+	{
+		for (;;)
+		{
+			const size_t newline = pending.find('\n');
+			if (newline != std::string::npos)
+			{
+				line.assign(pending, 0, newline);
+				pending.erase(0, newline + 1);
+				return 1;
+			}
+
+			char buf[0x1000];
+			const ssize_t received = recv(fd, buf, sizeof(buf), 0);
+			if (received < 0 && errno == EINTR) {
+				continue;
+			}
+
+			if (received <= 0)
+			{
+				if (pending.empty()) {
+					return 0;
+				}
+
+				line.swap(pending);
+				pending.clear();
+				return 1;
+			}
+
+			pending.append(buf, static_cast<size_t>(received));
+		}
+	}
+
+	void ServeSocket(int fd)
+	{
+		std::string pending;
+
+		Connection connection;
+		connection.mReadLine = [fd, &pending](std::string& line) { return ReceiveLine(fd, pending, line); };
+		connection.mWrite = [fd](const std::string& data) { SendAll(fd, data.data(), data.size()); };
+
+		Serve(connection);
+		close(fd);
+
+		std::lock_guard<std::mutex> lock(mConnectionMutex);
+		--mNumConnections;
+		mConnectionCondition.notify_all();
+	}
+
+	static bool GetSocketAddress(const char* path, sockaddr_un& address)
+	{
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+
+		if (strlen(path) >= sizeof(address.sun_path))
+		{
+			qPrintf("ERROR: Socket path %s is too long.\n", path);
+			return 0;
+		}
+
+		strcpy(address.sun_path, path);
+		return 1;
+	}
+
+	bool RunSocket(const char* path)
+	{
+		sockaddr_un address;
+		if (!GetSocketAddress(path, address)) {
+			return 0;
+		}
+
+		/* Only a socket left behind by an earlier server is replaced. */
+		struct stat fileStat;
+		if (!lstat(path, &fileStat) && S_ISSOCK(fileStat.st_mode)) {
+			unlink(path);
+		}
+
+		mListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (mListenSocket < 0 || bind(mListenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || listen(mListenSocket, SOMAXCONN))
+		{
+			qPrintf("ERROR: Failed to listen on %s (%s).\n", path, strerror(errno));
+
+			if (mListenSocket >= 0) {
+				close(mListenSocket);
+			}
+
+			return 0;
+		}
+
+		qPrintf("Serving jobs on %s with %u thread(s).\n", path, mOptions.mPool->GetNumThreads());
+		fflush(stdout);
+
+		while (!mStop)
+		{
+			const int fd = accept(mListenSocket, 0, 0);
+			if (fd < 0)
+			{
+				if (errno == EINTR) {
+					continue;
+				}
+
+				break;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mConnectionMutex);
+				++mNumConnections;
+			}
+
+			std::thread(&TCServer::ServeSocket, this, fd).detach();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mConnectionMutex);
+			mConnectionCondition.wait(lock, [this] { return !mNumConnections; });
+		}
+
+		close(mListenSocket);
+		mListenSocket = -1;
+		unlink(path);
+
+		PrintSummary();
+		return 1;
+	}
+#endif
+
+	/* target is a socket path, or - for stdin. */
+	bool Run(const char* target)
+	{
+		if (!strcmp(target, "-")) {
+			return RunStdin();
+		}
+
+#ifdef _WIN32
+		qPrintf("ERROR: Unix domain sockets are not supported on this platform, use -serve - instead.\n");
+		return 0;
+#else
+		return RunSocket(target);
+#endif
+	}
+};
+
+class TCClient
+{
+public:
+	/* Sends the jobs to a -serve socket and prints the answers, returns 0 if any job failed. */
+	static bool Run(const char* path, const std::vector<std::string>& jobs)
+	{
+#ifdef _WIN32
+		qPrintf("ERROR: Unix domain sockets are not supported on this platform.\n");
+		return 0;
+#else
+		sockaddr_un address;
+		if (!TCServer::GetSocketAddress(path, address)) {
+			return 0;
+		}
+
+		auto start = TCStats::Clock::now();
+
+		const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)))
+		{
+			qPrintf("ERROR: Failed to connect to %s (%s), is -serve running?\n", path, strerror(errno));
+
+			if (fd >= 0) {
+				close(fd);
+			}
+
+			return 0;
+		}
+
+		std::string request;
+		for (auto& job : jobs)
+		{
+			request += job;
+			request += '\n';
+		}
+
+		if (!TCServer::SendAll(fd, request.data(), request.size()))
+		{
+			qPrintf("ERROR: Failed to send the jobs to %s.\n", path);
+			close(fd);
+			return 0;
+		}
+
+		shutdown(fd, SHUT_WR);
+
+		u32 numAnswered = 0;
+		u32 numFailed = 0;
+
+		std::string pending;
+		for (std::string line; TCServer::ReceiveLine(fd, pending, line);)
+		{
+			qPrintf("%s\n", line.c_str());
+
+			/* Status lines are "@<n> ok|fail <ms> ms", output lines "@<n>: <text>". */
+			const size_t space = line.find(' ');
+			if (line[0] == '@' && space != std::string::npos && line[space - 1] != ':')
+			{
+				++numAnswered;
+				numFailed += !line.compare(space + 1, 4, "fail");
+			}
+		}
+
+		close(fd);
+
+		qPrintf("%u of %u job(s) answered, %u failed, round trip %.3f ms.\n", numAnswered, static_cast<u32>(jobs.size()), numFailed, TCStats::ToMilliseconds(TCStats::Clock::now() - start));
+		return (numAnswered == jobs.size() && !numFailed);
+#endif
+	}
+};
@@ -0,0 +1,424 @@
+#pragma once
+#include "arena.hh"
+#include "vocabulary.hh"
+#include "xmlstream.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Typed staging arrays filled by a single streaming pass over the XML.
+///
+///		Every element kind is appended to its own growable array and children are referenced
+///		by (first, count) ranges, strings are kept in one pool and referenced by offset.
+///		The counts needed by TCDatabaseScriber::BuildSchema fall out of the array sizes.
+///		The arrays are taken from the job's arena when the stage is given one. Tag and attribute
+///		names are mapped to ETCXMLName through the vocabulary's perfect hash.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCDatabaseStage
+{
+public:
+	struct Range
+	{
+		u32 mFirst = 0;
+		u32 mCount = 0;
+	};
+
+	struct EntityComponent
+	{
+		u32 mName;
+		int mResourceIndex;
+		int mRequired;
+		Range mBoneUIDs;
+	};
+
+	struct Entity
+	{
+		u32 mName;
+		Range mComponents;
+	};
+
+	struct ModelPart
+	{
+		u32 mName;
+		int mIsSkinned;
+		int mMorphType;
+	};
+
+	struct LOD
+	{
+		Range mModelParts;
+	};
+
+	struct ColourTint
+	{
+		int r, g, b;
+	};
+
+	struct OverrideParam
+	{
+		u32 mSampler;
+		u32 mNameUID;
+		u32 mUID[3];
+	};
+
+	struct TextureSet
+	{
+		u32 mName;
+		u32 mHighResolutionResource;
+		Range mColourTints;
+		Range mOverrideParams;
+	};
+
+	struct Resource
+	{
+		u32 mName;
+		int mType;
+		u32 mHighResolutionResource;
+		Range mLODs;
+		Range mTextureSets;
+		Range mTags;
+	};
+
+	struct Component
+	{
+		u32 mName;
+		u32 mNumChildren;
+		Range mResources;
+	};
+
+	static constexpr u32 InvalidString = ~0u;
+
+	TCArena* mArena;
+
+	TCArenaVector<char> mStrings{ TCArenaAllocator<char>(mArena) };
+
+	TCArenaVector<Entity> mEntities{ TCArenaAllocator<Entity>(mArena) };
+	TCArenaVector<EntityComponent> mEntityComponents{ TCArenaAllocator<EntityComponent>(mArena) };
+	TCArenaVector<u32> mBoneUIDs{ TCArenaAllocator<u32>(mArena) };
+	TCArenaVector<u32> mTags{ TCArenaAllocator<u32>(mArena) };
+
+	TCArenaVector<Component> mComponents{ TCArenaAllocator<Component>(mArena) };
+	TCArenaVector<Resource> mResources{ TCArenaAllocator<Resource>(mArena) };
+	TCArenaVector<u32> mResourceTags{ TCArenaAllocator<u32>(mArena) };
+	TCArenaVector<LOD> mLODs{ TCArenaAllocator<LOD>(mArena) };
+	TCArenaVector<ModelPart> mModelParts{ TCArenaAllocator<ModelPart>(mArena) };
+	TCArenaVector<TextureSet> mTextureSets{ TCArenaAllocator<TextureSet>(mArena) };
+	TCArenaVector<ColourTint> mColourTints{ TCArenaAllocator<ColourTint>(mArena) };
+	TCArenaVector<OverrideParam> mOverrideParams{ TCArenaAllocator<OverrideParam>(mArena) };
+
+	bool mHasTCDB = 0;
+	bool mHasDefinition = 0;
+	bool mHasTags = 0;
+	bool mHasComponentEntries = 0;
+
+	u32 mNumTagsChildren = 0;
+	u32 mNumComponentEntriesChildren = 0;
+	u32 mNumResourceEntries = 0;
+	u32 mStringBufferSize = 0;
+
+	TCDatabaseStage(TCArena* arena = 0) : mArena(arena) {}
+
+	const char* GetString(u32 offset) const { return &mStrings[offset]; }
+
+	u32 AddString(const char* str)
+	{
+		if (!str) {
+			str = "";
+		}
+
+		const u32 offset = static_cast<u32>(mStrings.size());
+		mStrings.insert(mStrings.end(), str, str + qStringLength(str) + 1);
+		return offset;
+	}
+
+	/* Same as AddString, but also accounts the bytes the name takes in the scribed StringBuffer. */
+	u32 AddBufferString(const char* str)
+	{
+		const u32 offset = AddString(str);
+		mStringBufferSize += static_cast<u32>(mStrings.size()) - offset;
+		return offset;
+	}
+
+	//------------------------------------
+	//	Parse
+	//------------------------------------
+
+	enum ENodeKind
+	{
+		NODE_ROOT,
+		NODE_IGNORED,
+		NODE_TCDB,
+		NODE_DEFINITION,
+		NODE_ENTITY,
+		NODE_ENTITY_COMPONENT,
+		NODE_BONE_UID,
+		NODE_TAGS,
+		NODE_TAG_LIST_TAG,
+		NODE_COMPONENT_ENTRIES,
+		NODE_COMPONENT,
+		NODE_RESOURCE,
+		NODE_RESOURCE_TAG,
+		NODE_RESOURCE_HIGH_RES,
+		NODE_LOD,
+		NODE_MODEL_PART,
+		NODE_TEXTURE_SET,
+		NODE_TEXTURE_SET_HIGH_RES,
+		NODE_COLOUR_TINT,
+		NODE_OVERRIDE_PARAM
+	};
+
+	struct StackEntry
+	{
+		ENodeKind mKind;
+		u32 mNumChildren;
+	};
+
+	TCArenaVector<StackEntry> mStack{ TCArenaAllocator<StackEntry>(mArena) };
+	std::string mValue;
+
+	/* Only the first <TrueCrowdDataBase>, <Definition>, <Tags> and <ComponentEntries> are used, same as XMLDocument::GetChildNode. */
+	ENodeKind GetNodeKind(ENodeKind parent, ETCXMLName name)
+	{
+		switch (parent)
+		{
+		default:
+			return NODE_IGNORED;
+		case NODE_ROOT:
+			return (!mHasTCDB && name == XNAME_TCDB ? NODE_TCDB : NODE_IGNORED);
+		case NODE_TCDB:
+			if (!mHasDefinition && name == XNAME_DEFINITION) {
+				return NODE_DEFINITION;
+			}
+			if (!mHasComponentEntries && name == XNAME_COMPONENT_ENTRIES) {
+				return NODE_COMPONENT_ENTRIES;
+			}
+			return NODE_IGNORED;
+		case NODE_DEFINITION:
+			if (name == XNAME_ENTITY) {
+				return NODE_ENTITY;
+			}
+			if (!mHasTags && name == XNAME_TAGS) {
+				return NODE_TAGS;
+			}
+			return NODE_IGNORED;
+		case NODE_ENTITY:
+			return (name == XNAME_ENTITY_COMPONENT ? NODE_ENTITY_COMPONENT : NODE_IGNORED);
+		case NODE_ENTITY_COMPONENT:
+			return (name == XNAME_BONE_UID ? NODE_BONE_UID : NODE_IGNORED);
+		case NODE_TAGS:
+			return (name == XNAME_TAG ? NODE_TAG_LIST_TAG : NODE_IGNORED);
+		case NODE_COMPONENT_ENTRIES:
+			return (name == XNAME_COMPONENT ? NODE_COMPONENT : NODE_IGNORED);
+		case NODE_COMPONENT:
+			return (name == XNAME_RESOURCE ? NODE_RESOURCE : NODE_IGNORED);
+		case NODE_RESOURCE:
+			switch (name)
+			{
+			case XNAME_TAG:
+				return NODE_RESOURCE_TAG;
+			case XNAME_LOD:
+				return NODE_LOD;
+			case XNAME_TEXTURE_SET:
+				return NODE_TEXTURE_SET;
+			case XNAME_HIGH_RESOLUTION_RESOURCE:
+				return (mResources.back().mHighResolutionResource == InvalidString ? NODE_RESOURCE_HIGH_RES : NODE_IGNORED);
+			default:
+				return NODE_IGNORED;
+			}
+		case NODE_LOD:
+			return (name == XNAME_MODEL_PART ? NODE_MODEL_PART : NODE_IGNORED);
+		case NODE_TEXTURE_SET:
+			switch (name)
+			{
+			case XNAME_COLOUR_TINT:
+				return NODE_COLOUR_TINT;
+			case XNAME_OVERRIDE_PARAM:
+				return NODE_OVERRIDE_PARAM;
+			case XNAME_HIGH_RESOLUTION_RESOURCE:
+				return (mTextureSets.back().mHighResolutionResource == InvalidString ? NODE_TEXTURE_SET_HIGH_RES : NODE_IGNORED);
+			default:
+				return NODE_IGNORED;
+			}
+		}
+	}
+
+	bool OnBeginNode(const char* name, const XMLEventReader::Attribute* attributes, u32 numAttributes)
+	{
+		auto& parent = mStack.back();
+		++parent.mNumChildren;
+
+		const ETCXMLName tag = TCXMLVocabulary::Find(name, static_cast<u32>(strlen(name)));
+
+		/* Attribute values by name, the first of duplicated attributes wins like XMLEventReader::GetAttribute. */
+		const char* values[TCXMLVocabulary::NumAttributes] = {};
+
+		for (u32 i = 0; numAttributes > i; ++i)
+		{
+			const ETCXMLName attr = TCXMLVocabulary::Find(attributes[i].mName, attributes[i].mNameLength);
+			if (!TCXMLVocabulary::IsAttribute(attr)) {
+				continue;
+			}
+
+			auto& value = values[attr - TCXMLVocabulary::FirstAttribute];
+			if (!value) {
+				value = attributes[i].mValue;
+			}
+		}
+
+		auto GetAttribute = [&values](ETCXMLName attr) { return values[attr - TCXMLVocabulary::FirstAttribute]; };
+		auto GetInt = [&values](ETCXMLName attr, int defaultValue) { auto value = values[attr - TCXMLVocabulary::FirstAttribute]; return (value ? XMLEventReader::ParseInt(value) : defaultValue); };
+		auto GetUInt = [&values](ETCXMLName attr) { auto value = values[attr - TCXMLVocabulary::FirstAttribute]; return (value ? XMLEventReader::ParseUInt(value) : 0u); };
+
+		const ENodeKind kind = GetNodeKind(parent.mKind, tag);
+		switch (kind)
+		{
+		default:
+			break;
+		case NODE_TCDB:
+			mHasTCDB = 1;
+			break;
+		case NODE_DEFINITION:
+			mHasDefinition = 1;
+			break;
+		case NODE_TAGS:
+			mHasTags = 1;
+			break;
+		case NODE_COMPONENT_ENTRIES:
+			mHasComponentEntries = 1;
+			break;
+		case NODE_ENTITY:
+			mEntities.push_back({ AddString(GetAttribute(XNAME_NAME)), { static_cast<u32>(mEntityComponents.size()), 0 } });
+			break;
+		case NODE_ENTITY_COMPONENT:
+			mEntityComponents.push_back({ AddString(GetAttribute(XNAME_NAME)), GetInt(XNAME_RESOURCE_INDEX, 0), GetInt(XNAME_REQUIRED, 0), { static_cast<u32>(mBoneUIDs.size()), 0 } });
+			++mEntities.back().mComponents.mCount;
+			break;
+		case NODE_COMPONENT:
+			mComponents.push_back({ AddString(GetAttribute(XNAME_NAME)), 0, { static_cast<u32>(mResources.size()), 0 } });
+			break;
+		case NODE_RESOURCE:
+		{
+			Resource resource;
+			resource.mName = AddBufferString(GetAttribute(XNAME_NAME));
+			resource.mType = GetInt(XNAME_TYPE, TrueCrowdResource::Invalid);
+			resource.mHighResolutionResource = InvalidString;
+			resource.mLODs.mFirst = static_cast<u32>(mLODs.size());
+			resource.mTextureSets.mFirst = static_cast<u32>(mTextureSets.size());
+			resource.mTags.mFirst = static_cast<u32>(mResourceTags.size());
+			mResources.push_back(resource);
+			++mComponents.back().mResources.mCount;
+			break;
+		}
+		case NODE_RESOURCE_HIGH_RES:
+			mResources.back().mHighResolutionResource = AddString(GetAttribute(XNAME_NAME));
+			break;
+		case NODE_LOD:
+			mLODs.push_back({ { static_cast<u32>(mModelParts.size()), 0 } });
+			++mResources.back().mLODs.mCount;
+			break;
+		case NODE_MODEL_PART:
+			mModelParts.push_back({ AddBufferString(GetAttribute(XNAME_NAME)), GetInt(XNAME_IS_SKINNED, 0), GetInt(XNAME_MORPH_TYPE, 0) });
+			++mLODs.back().mModelParts.mCount;
+			break;
+		case NODE_TEXTURE_SET:
+		{
+			TextureSet textureSet;
+			textureSet.mName = AddBufferString(GetAttribute(XNAME_NAME));
+			textureSet.mHighResolutionResource = InvalidString;
+			textureSet.mColourTints.mFirst = static_cast<u32>(mColourTints.size());
+			textureSet.mOverrideParams.mFirst = static_cast<u32>(mOverrideParams.size());
+			mTextureSets.push_back(textureSet);
+			++mResources.back().mTextureSets.mCount;
+			break;
+		}
+		case NODE_TEXTURE_SET_HIGH_RES:
+			mTextureSets.back().mHighResolutionResource = AddString(GetAttribute(XNAME_NAME));
+			break;
+		case NODE_COLOUR_TINT:
+			mColourTints.push_back({ GetInt(XNAME_R, 0), GetInt(XNAME_G, 0), GetInt(XNAME_B, 0) });
+			++mTextureSets.back().mColourTints.mCount;
+			break;
+		case NODE_OVERRIDE_PARAM:
+			mOverrideParams.push_back({ AddString(GetAttribute(XNAME_SAMPLER)), GetUInt(XNAME_NAME_UID), { GetUInt(XNAME_UID0), GetUInt(XNAME_UID1), GetUInt(XNAME_UID2) } });
+			++mTextureSets.back().mOverrideParams.mCount;
+			break;
+		}
+
+		mStack.push_back({ kind, 0 });
+		mValue.clear();
+		return 1;
+	}
+
+	bool OnValue(const char* value)
+	{
+		mValue += value;
+		return 1;
+	}
+
+	/* The reader has already matched the end tag against the open element. */
+	bool OnEndNode(const char* /*name*/)
+	{
+		auto entry = mStack.back();
+		mStack.pop_back();
+
+		switch (entry.mKind)
+		{
+		default:
+			break;
+		case NODE_BONE_UID:
+			mBoneUIDs.push_back(AddString(mValue.c_str()));
+			++mEntityComponents.back().mBoneUIDs.mCount;
+			break;
+		case NODE_TAG_LIST_TAG:
+			mTags.push_back(AddString(mValue.c_str()));
+			break;
+		case NODE_RESOURCE_TAG:
+			mResourceTags.push_back(AddString(mValue.c_str()));
+			++mResources.back().mTags.mCount;
+			break;
+		case NODE_TAGS:
+			mNumTagsChildren = entry.mNumChildren;
+			break;
+		case NODE_COMPONENT_ENTRIES:
+			mNumComponentEntriesChildren = entry.mNumChildren;
+			break;
+		case NODE_COMPONENT:
+			mComponents.back().mNumChildren = entry.mNumChildren;
+			mNumResourceEntries += entry.mNumChildren;
+			break;
+		}
+
+		mValue.clear();
+		return 1;
+	}
+
+	bool Parse(XMLEventReader& reader)
+	{
+		mStack.clear();
+		mStack.push_back({ NODE_ROOT, 0 });
+
+		if (!reader.Parse(*this)) {
+			return 0;
+		}
+
+		mStack.clear();
+		mStack.shrink_to_fit();
+		return 1;
+	}
+
+	bool Open(const char* filename)
+	{
+		XMLEventReader reader;
+		return reader.Open(filename) && Parse(reader);
+	}
+
+	bool Open(const void* data, size_t size)
+	{
+		XMLEventReader reader;
+		reader.SetMemory(data, size);
+		return Parse(reader);
+	}
+};
@@ -0,0 +1,180 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Phase timings and counters of one conversion or scribe job, written as JSON (-stats).
+///
+///		Phases are kept in the order they first ran, running a phase again adds to its time.
+///		The export phases of the converter include the writes the XML writer did meanwhile,
+///		writer_flush reports the total time spent in those writes, or waiting for them when
+///		the writes are async.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCStats
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Phase
+	{
+		const char* mName;
+		double mMilliseconds;
+	};
+
+	struct Counter
+	{
+		const char* mName;
+		u64 mValue;
+	};
+
+	const char* mPipeline = "";
+	std::string mInput;
+	std::string mOutput;
+
+	std::vector<Phase> mPhases;
+	std::vector<Counter> mCounters;
+
+	static double ToMilliseconds(Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+
+	void AddPhase(const char* name, double ms)
+	{
+		for (auto& phase : mPhases)
+		{
+			if (!strcmp(phase.mName, name))
+			{
+				phase.mMilliseconds += ms;
+				return;
+			}
+		}
+
+		mPhases.push_back({ name, ms });
+	}
+
+	void AddPhase(const char* name, Clock::time_point start) { AddPhase(name, ToMilliseconds(Clock::now() - start)); }
+
+	void SetCounter(const char* name, u64 value)
+	{
+		for (auto& counter : mCounters)
+		{
+			if (!strcmp(counter.mName, name))
+			{
+				counter.mValue = value;
+				return;
+			}
+		}
+
+		mCounters.push_back({ name, value });
+	}
+
+	/* Times the enclosing scope, does nothing without stats. */
+	class ScopedPhase
+	{
+	public:
+		TCStats* mStats;
+		const char* mName;
+		Clock::time_point mStart;
+
+		ScopedPhase(TCStats* stats, const char* name) : mStats(stats), mName(name)
+		{
+			if (mStats) {
+				mStart = Clock::now();
+			}
+		}
+
+		~ScopedPhase()
+		{
+			if (mStats) {
+				mStats->AddPhase(mName, mStart);
+			}
+		}
+	};
+
+	//------------------------------------
+	//	JSON
+	//------------------------------------
+
+	static void AppendString(std::string& json, const char* str)
+	{
+		json += '"';
+
+		for (; *str; ++str)
+		{
+			const char c = *str;
+			if (c == '"' || c == '\\')
+			{
+				json += '\\';
+				json += c;
+			}
+			else if (static_cast<u8>(c) < 0x20)
+			{
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04X", static_cast<u8>(c));
+				json += buf;
+			}
+			else {
+				json += c;
+			}
+		}
+
+		json += '"';
+	}
+
+	std::string ToJSON() const
+	{
+		std::string json = "{\n\t\"pipeline\": ";
+		AppendString(json, mPipeline);
+		json += ",\n\t\"input\": ";
+		AppendString(json, mInput.c_str());
+		json += ",\n\t\"output\": ";
+		AppendString(json, mOutput.c_str());
+
+		json += ",\n\t\"phases_ms\": {";
+
+		char buf[64];
+		for (size_t i = 0; mPhases.size() > i; ++i)
+		{
+			json += (i ? ",\n\t\t" : "\n\t\t");
+			AppendString(json, mPhases[i].mName);
+
+			snprintf(buf, sizeof(buf), ": %.3f", mPhases[i].mMilliseconds);
+			json += buf;
+		}
+
+		json += "\n\t},\n\t\"counters\": {";
+
+		for (size_t i = 0; mCounters.size() > i; ++i)
+		{
+			json += (i ? ",\n\t\t" : "\n\t\t");
+			AppendString(json, mCounters[i].mName);
+
+			snprintf(buf, sizeof(buf), ": %llu", static_cast<unsigned long long>(mCounters[i].mValue));
+			json += buf;
+		}
+
+		json += "\n\t}\n}\n";
+		return json;
+	}
+
+	bool Write(const char* filename) const
+	{
+		auto f = qOpen(filename, QACCESS_WRITE);
+		if (!f)
+		{
+			qPrintf("ERROR: Failed to open %s for writing.\n", filename);
+			return 0;
+		}
+
+		const std::string json = ToJSON();
+		qWriteString(f, json.c_str(), static_cast<s64>(json.size()));
+		qClose(f);
+
+		qPrintf("Stats have been exported to: %s\n", filename);
+		return 1;
+	}
+};
@@ -0,0 +1,450 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "platform.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Compiled symbol dictionary (.tcsym) for fast -qsymbols startup.
+///
+///		Layout: Header, sorted u32 UIDs[mNumSymbols], u32 string offsets[mNumSymbols] and the
+///		string pool of null terminated strings. The file is mapped and searched in place, so
+///		loading it costs no parsing or allocations.
+///
+///		Dictionaries are compiled from text sources of "0xUID name" lines, like the
+///		_qsymbols.txt files written by the scriber. Text sources given to -qsymbols are merged
+///		into one dictionary in memory the same way, so names from our own XML resolve on the
+///		next -conv. The QSymbol table resources can not be enumerated, they are still loaded
+///		as before and searched after the dictionaries.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCSymbolDictionary
+{
+public:
+	static constexpr u32 Magic = 0x44534354; // "TCSD"
+	static constexpr u32 Version = 1;
+
+	struct Header
+	{
+		u32 mMagic;
+		u32 mVersion;
+		u32 mNumSymbols;
+		u32 mPoolSize;
+	};
+
+	FileMapping mMapping;
+
+	/* Storage of a dictionary built in memory. */
+	std::vector<u32> mUIDStorage;
+	std::vector<u32> mOffsetStorage;
+	std::vector<char> mPoolStorage;
+
+	const u32* mUIDs = 0;
+	const u32* mOffsets = 0;
+	const char* mPool = 0;
+	u32 mNumSymbols = 0;
+	u32 mPoolSize = 0;
+
+	const char* Find(u32 uid) const
+	{
+		auto end = mUIDs + mNumSymbols;
+		auto it = std::lower_bound(mUIDs, end, uid);
+		if (it == end || *it != uid) {
+			return 0;
+		}
+
+		const u32 offset = mOffsets[it - mUIDs];
+		return (mPoolSize > offset ? &mPool[offset] : 0);
+	}
+
+	static bool HasMagic(const void* data, u64 size)
+	{
+		u32 magic;
+		if (sizeof(magic) > size) {
+			return 0;
+		}
+
+		qMemCopy(&magic, data, sizeof(magic));
+		return magic == Magic;
+	}
+
+	//------------------------------------
+	//	Load
+	//------------------------------------
+
+	/* Returns 0 without a message if the file is not a dictionary, so it can be loaded as symbol table resource instead. */
+	bool Open(const char* filename)
+	{
+		if (!mMapping.Open(filename) || !HasMagic(mMapping.mData, mMapping.mSize))
+		{
+			mMapping.Close();
+			return 0;
+		}
+
+		Header header;
+		if (sizeof(header) > mMapping.mSize) {
+			return Invalid(filename);
+		}
+
+		qMemCopy(&header, mMapping.mData, sizeof(header));
+
+		const u64 size = sizeof(Header) + static_cast<u64>(header.mNumSymbols) * sizeof(u32) * 2 + header.mPoolSize;
+		if (header.mVersion != Version || size > mMapping.mSize) {
+			return Invalid(filename);
+		}
+
+		auto data = static_cast<const u8*>(mMapping.mData) + sizeof(Header);
+
+		mUIDs = reinterpret_cast<const u32*>(data);
+		mOffsets = mUIDs + header.mNumSymbols;
+		mPool = reinterpret_cast<const char*>(mOffsets + header.mNumSymbols);
+		mNumSymbols = header.mNumSymbols;
+		mPoolSize = header.mPoolSize;
+
+		if (mPoolSize && mPool[mPoolSize - 1]) {
+			return Invalid(filename);
+		}
+
+		return 1;
+	}
+
+	/* Keeps the mapping, so Load does not retry the file as symbol table resource. */
+	bool Invalid(const char* filename)
+	{
+		qPrintf("ERROR: Symbol dictionary %s is invalid.\n", filename);
+
+		mUIDs = mOffsets = 0;
+		mPool = 0;
+		mNumSymbols = mPoolSize = 0;
+		return 0;
+	}
+
+	//------------------------------------
+	//	Write
+	//------------------------------------
+
+	bool Write(const char* filename) const
+	{
+		auto f = qOpen(filename, QACCESS_WRITE);
+		if (!f)
+		{
+			qPrintf("ERROR: Failed to open %s for writing.\n", filename);
+			return 0;
+		}
+
+		const Header header = { Magic, Version, mNumSymbols, mPoolSize };
+		qWriteString(f, reinterpret_cast<const char*>(&header), sizeof(header));
+		qWriteString(f, reinterpret_cast<const char*>(mUIDs), static_cast<s64>(mNumSymbols) * sizeof(u32));
+		qWriteString(f, reinterpret_cast<const char*>(mOffsets), static_cast<s64>(mNumSymbols) * sizeof(u32));
+		qWriteString(f, mPool, mPoolSize);
+		qClose(f);
+
+		qPrintf("Compiled %u symbol(s) to: %s\n", mNumSymbols, filename);
+		return 1;
+	}
+
+	//------------------------------------
+	//	Lookup
+	//------------------------------------
+
+	static std::vector<std::unique_ptr<TCSymbolDictionary>>& GetLoaded()
+	{
+		static std::vector<std::unique_ptr<TCSymbolDictionary>> dictionaries;
+		return dictionaries;
+	}
+
+	/* Loaded dictionaries first, then the symbol table resources. Dictionaries are only added at startup, lookups are thread safe. */
+	static const char* Lookup(u32 uid)
+	{
+		for (auto& dictionary : GetLoaded())
+		{
+			if (auto str = dictionary->Find(uid)) {
+				return str;
+			}
+		}
+
+		return qSymbolLookupStringFromSymbolTableResources(uid);
+	}
+};
+
+class TCSymbolCompiler
+{
+public:
+	static constexpr u32 MaxConflictWarnings = 10;
+
+	/* Sources stay mapped until Build, entries point into them. */
+	struct Source
+	{
+		FileMapping mMapping;
+		std::string mFilename;
+	};
+
+	struct Entry
+	{
+		u32 mUID;
+		u32 mSource;
+		const char* mStr;
+		u32 mLength;
+	};
+
+	std::vector<std::unique_ptr<Source>> mSources;
+	std::vector<Entry> mEntries;
+
+	u32 mNumDuplicates = 0;
+	u32 mNumConflicts = 0;
+
+	/* A .txt extension or "0x" first, after blanks and '#' comment lines, tells text sources from binary resources. */
+	static bool IsTextSource(const void* data, u64 size)
+	{
+		auto it = static_cast<const char*>(data);
+		auto end = it + size;
+
+		while (end > it)
+		{
+			if (*it == '#')
+			{
+				auto lineEnd = static_cast<const char*>(memchr(it, '\n', static_cast<size_t>(end - it)));
+				it = (lineEnd ? lineEnd + 1 : end);
+			}
+			else if (*it == ' ' || *it == '\t' || *it == '\r' || *it == '\n') {
+				++it;
+			}
+			else {
+				return (end - it > 2 && it[0] == '0' && (it[1] == 'x' || it[1] == 'X'));
+			}
+		}
+
+		return 0;
+	}
+
+	static bool IsTextSource(const char* filename)
+	{
+		auto extension = strrchr(filename, '.');
+		if (extension && !qStringCompareInsensitive(extension, ".txt")) {
+			return 1;
+		}
+
+		FileMapping mapping;
+		return mapping.Open(filename) && IsTextSource(mapping.mData, mapping.mSize);
+	}
+
+	/* Lines of "0xUID name", empty lines and lines starting with '#' are skipped. */
+	bool AddTextFile(const char* filename)
+	{
+		std::unique_ptr<Source> source(new Source);
+		source->mFilename = filename;
+
+		if (!source->mMapping.Open(filename))
+		{
+			qPrintf("ERROR: Failed to open symbol source %s.\n", filename);
+			return 0;
+		}
+
+		auto it = static_cast<const char*>(source->mMapping.mData);
+		auto end = it + source->mMapping.mSize;
+
+		const u32 sourceIndex = static_cast<u32>(mSources.size());
+		mSources.push_back(std::move(source));
+
+		/* Scriber lines are "0x%08X name\n", about 24 bytes on average. */
+		mEntries.reserve(mEntries.size() + static_cast<size_t>(end - it) / 24);
+
+		u32 line = 0;
+		u32 numInvalidLines = 0;
+
+		while (end > it)
+		{
+			auto lineEnd = static_cast<const char*>(memchr(it, '\n', static_cast<size_t>(end - it)));
+			if (!lineEnd) {
+				lineEnd = end;
+			}
+
+			++line;
+
+			while (lineEnd > it && (*it == ' ' || *it == '\t')) {
+				++it;
+			}
+
+			auto strEnd = lineEnd;
+			while (strEnd > it && (strEnd[-1] == '\r' || strEnd[-1] == ' ' || strEnd[-1] == '\t')) {
+				--strEnd;
+			}
+
+			if (strEnd > it && *it != '#')
+			{
+				u32 uid;
+				auto str = ParseUID(it, strEnd, uid);
+
+				while (str && strEnd > str && (*str == ' ' || *str == '\t')) {
+					++str;
+				}
+
+				if (str && strEnd > str) {
+					mEntries.push_back({ uid, sourceIndex, str, static_cast<u32>(strEnd - str) });
+				}
+				else if (!numInvalidLines++) {
+					qPrintf("WARN: Invalid symbol line %u in %s.\n", line, filename);
+				}
+			}
+
+			it = lineEnd + 1;
+		}
+
+		if (numInvalidLines > 1) {
+			qPrintf("WARN: Skipped %u invalid symbol line(s) in %s.\n", numInvalidLines, filename);
+		}
+
+		return 1;
+	}
+
+	/* Hexadecimal with optional 0x prefix followed by a blank, returns 0 if the line does not start with one. */
+	static const char* ParseUID(const char* it, const char* end, u32& uid)
+	{
+		if (end - it > 2 && it[0] == '0' && (it[1] == 'x' || it[1] == 'X')) {
+			it += 2;
+		}
+
+		uid = 0;
+
+		u32 numDigits = 0;
+		for (; end > it && 8 > numDigits; ++it, ++numDigits)
+		{
+			const char c = *it;
+			const u32 digit = (c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16);
+			if (digit == 16) {
+				break;
+			}
+
+			uid = (uid << 4) | digit;
+		}
+
+		if (!numDigits || end == it || (*it != ' ' && *it != '\t')) {
+			return 0;
+		}
+
+		return it;
+	}
+
+	/* Sorts by UID and drops duplicates, on conflicts the first source wins. Releases the sources. */
+	void Build(TCSymbolDictionary& dictionary)
+	{
+		std::stable_sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b) { return a.mUID < b.mUID; });
+
+		dictionary.mUIDStorage.clear();
+		dictionary.mOffsetStorage.clear();
+		dictionary.mPoolStorage.clear();
+
+		size_t poolSize = 0;
+		for (auto& entry : mEntries) {
+			poolSize += entry.mLength + 1;
+		}
+
+		dictionary.mUIDStorage.reserve(mEntries.size());
+		dictionary.mOffsetStorage.reserve(mEntries.size());
+		dictionary.mPoolStorage.reserve(poolSize);
+
+		const Entry* first = 0;
+		for (auto& entry : mEntries)
+		{
+			if (first && first->mUID == entry.mUID)
+			{
+				if (first->mLength != entry.mLength || memcmp(first->mStr, entry.mStr, entry.mLength))
+				{
+					if (MaxConflictWarnings > mNumConflicts)
+					{
+						qPrintf("WARN: Symbol 0x%08X is %.*s in %s and %.*s in %s, keeping the first.\n", entry.mUID,
+							static_cast<int>(first->mLength), first->mStr, mSources[first->mSource]->mFilename.c_str(),
+							static_cast<int>(entry.mLength), entry.mStr, mSources[entry.mSource]->mFilename.c_str());
+					}
+
+					++mNumConflicts;
+				}
+				else {
+					++mNumDuplicates;
+				}
+
+				continue;
+			}
+
+			first = &entry;
+
+			dictionary.mUIDStorage.push_back(entry.mUID);
+			dictionary.mOffsetStorage.push_back(static_cast<u32>(dictionary.mPoolStorage.size()));
+			dictionary.mPoolStorage.insert(dictionary.mPoolStorage.end(), entry.mStr, entry.mStr + entry.mLength);
+			dictionary.mPoolStorage.push_back('\0');
+		}
+
+		dictionary.mUIDs = dictionary.mUIDStorage.data();
+		dictionary.mOffsets = dictionary.mOffsetStorage.data();
+		dictionary.mPool = dictionary.mPoolStorage.data();
+		dictionary.mNumSymbols = static_cast<u32>(dictionary.mUIDStorage.size());
+		dictionary.mPoolSize = static_cast<u32>(dictionary.mPoolStorage.size());
+
+		if (mNumConflicts) {
+			qPrintf("WARN: %u conflicting symbol(s) were skipped.\n", mNumConflicts);
+		}
+
+		mEntries.clear();
+		mSources.clear();
+	}
+};
+
+class TCSymbolLoader
+{
+public:
+	u32 mNumTextSymbols = 0;
+	u32 mNumTextSources = 0;
+
+	/*
+		Compiled dictionaries are mapped, text sources are merged into one dictionary searched after them,
+		anything else is loaded as QSymbol table resource. Returns 0 if any of the files failed to load.
+	*/
+	bool Load(const std::vector<const char*>& filenames)
+	{
+		bool result = 1;
+		TCSymbolCompiler compiler;
+
+		for (auto filename : filenames)
+		{
+			std::unique_ptr<TCSymbolDictionary> dictionary(new TCSymbolDictionary);
+			if (dictionary->Open(filename))
+			{
+				TCSymbolDictionary::GetLoaded().push_back(std::move(dictionary));
+				continue;
+			}
+
+			/* Mapped but invalid dictionary. */
+			if (dictionary->mMapping.mData)
+			{
+				result = 0;
+				continue;
+			}
+
+			if (TCSymbolCompiler::IsTextSource(filename))
+			{
+				result &= compiler.AddTextFile(filename);
+				continue;
+			}
+
+			result &= StreamResourceLoader::LoadResourceFile(filename);
+		}
+
+		mNumTextSources = static_cast<u32>(compiler.mSources.size());
+
+		if (!compiler.mEntries.empty())
+		{
+			std::unique_ptr<TCSymbolDictionary> dictionary(new TCSymbolDictionary);
+			compiler.Build(*dictionary);
+
+			mNumTextSymbols = dictionary->mNumSymbols;
+			TCSymbolDictionary::GetLoaded().push_back(std::move(dictionary));
+		}
+
+		return result;
+	}
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Library entry point, include after theory/theory.hh.
+///
+///		Brings in the loader, converter, scriber and the jobs shared with the command line. An
+///		embedding service uses ConvertBuffer and ScribeBuffer to go from binary chunk bytes to
+///		XML bytes and back, or the *File jobs for files on disk. Engine writers that only take
+///		filenames (SimpleXML::XMLWriter, qChunkFileBuilder) go through a temporary file for the
+///		buffer jobs, so both give the same bytes as the file jobs.
+///		Scribers hold GetSchemaMutex() from schema allocation until the chunk is copied out since
+///		the schema is a process wide singleton, parsing and counting still run concurrently,
+///		and the symbol table is loaded once by the caller (TCSymbolLoader).
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define XTag_TCDB						"TrueCrowdDataBase"
+#define XTag_Definition					"Definition"
+#define XTag_Entity						"Entity"
+#define XTag_EntityComponent			"EntityComponent"
+#define XTag_BoneUID					"BoneUID"
+#define XTag_Tags						"Tags"
+#define XTag_Tag						"Tag"
+#define XTag_ComponentEntries			"ComponentEntries"
+#define XTag_Component					"Component"
+#define XTag_Resource					"Resource"
+#define XTag_HighResolutionResource		"HighResolutionResource"
+#define XTag_LOD						"LOD"
+#define XTag_ModelPart					"ModelPart"
+#define XTag_TextureSet					"TextureSet"
+#define XTag_ColourTint					"ColourTint"
+#define XTag_OverrideParam				"OverrideParam"
+
+#define XAttr_Name						"name"
+#define XAttr_NameUID					"nameUID"
+#define XAttr_ResourceIndex				"resourceIndex"
+#define XAttr_Required					"required"
+#define XAttr_Type						"type"
+#define XAttr_IsSkinned					"isSkinned"
+#define XAttr_MorphType					"morphType"
+#define XAttr_Sampler					"sampler"
+#define XAttr_UID0						"uid0"
+#define XAttr_UID1						"uid1"
+#define XAttr_UID2						"uid2"
+
+#include "platform.hh"
+#include "loader.hh"
+#include "converter.hh"
+#include "scriber.hh"
+#include "jobs.hh"
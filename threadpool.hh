@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Work-stealing thread pool.
+///
+///		Every worker owns a task queue, tasks submitted from a worker go to its own queue and
+///		idle workers steal from the others. Tasks are tracked by a TaskGroup, waiting on a
+///		group runs its queued tasks on the calling thread so groups can be nested. Tasks of
+///		other groups are left to the workers, they could block the waiting thread.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	class TaskGroup
+	{
+	public:
+		std::atomic<u32> mPending = { 0 };
+	};
+
+	struct QueuedTask
+	{
+		Task mTask;
+		TaskGroup* mGroup;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex mMutex;
+		std::deque<QueuedTask> mTasks;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+	std::vector<std::thread> mThreads;
+
+	std::mutex mMutex;
+	std::condition_variable mWakeCondition;
+	std::condition_variable mDoneCondition;
+
+	std::atomic<u32> mNumQueued = { 0 };
+	std::atomic<u32> mNextQueue = { 0 };
+	bool mStop = 0;
+
+	static u32& GetWorkerIndex()
+	{
+		static thread_local u32 index = ~0u;
+		return index;
+	}
+
+	static u32 GetDefaultNumThreads()
+	{
+		const u32 numThreads = std::thread::hardware_concurrency();
+		return (numThreads ? numThreads : 1);
+	}
+
+	explicit ThreadPool(u32 numThreads = 0)
+	{
+		if (!numThreads) {
+			numThreads = GetDefaultNumThreads();
+		}
+
+		for (u32 i = 0; numThreads > i; ++i) {
+			mQueues.emplace_back(new WorkerQueue);
+		}
+
+		for (u32 i = 0; numThreads > i; ++i) {
+			mThreads.emplace_back(&ThreadPool::WorkerMain, this, i);
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = 1;
+		}
+
+		mWakeCondition.notify_all();
+
+		for (auto& thread : mThreads) {
+			thread.join();
+		}
+	}
+
+	u32 GetNumThreads() const { return static_cast<u32>(mThreads.size()); }
+
+	//------------------------------------
+	//	Tasks
+	//------------------------------------
+
+	void Submit(TaskGroup& group, Task task)
+	{
+		++group.mPending;
+
+		u32 index = GetWorkerIndex();
+		if (index >= mQueues.size()) {
+			index = mNextQueue++ % static_cast<u32>(mQueues.size());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			++mNumQueued;
+		}
+
+		{
+			auto queue = mQueues[index].get();
+			std::lock_guard<std::mutex> lock(queue->mMutex);
+			queue->mTasks.push_back({ std::move(task), &group });
+		}
+
+		mWakeCondition.notify_one();
+	}
+
+	/* Pops from the back of the own queue, steals from the front of the others. With a group only its tasks are taken. */
+	bool PopTask(u32 index, QueuedTask& task, const TaskGroup* group = 0)
+	{
+		const u32 numQueues = static_cast<u32>(mQueues.size());
+		auto isInGroup = [group](const QueuedTask& queued) { return !group || queued.mGroup == group; };
+
+		for (u32 i = 0; numQueues > i; ++i)
+		{
+			auto queue = mQueues[(index + i) % numQueues].get();
+			std::lock_guard<std::mutex> lock(queue->mMutex);
+
+			auto& tasks = queue->mTasks;
+			auto it = tasks.end();
+
+			if (!i)
+			{
+				auto last = std::find_if(tasks.rbegin(), tasks.rend(), isInGroup);
+				if (last != tasks.rend()) {
+					it = std::prev(last.base());
+				}
+			}
+			else {
+				it = std::find_if(tasks.begin(), tasks.end(), isInGroup);
+			}
+
+			if (it == tasks.end()) {
+				continue;
+			}
+
+			task = std::move(*it);
+			tasks.erase(it);
+
+			--mNumQueued;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	void RunTask(QueuedTask& task)
+	{
+		task.mTask();
+
+		if (--task.mGroup->mPending == 0)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDoneCondition.notify_all();
+		}
+	}
+
+	void WorkerMain(u32 index)
+	{
+		GetWorkerIndex() = index;
+
+		for (;;)
+		{
+			QueuedTask task;
+			if (PopTask(index, task))
+			{
+				RunTask(task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCondition.wait(lock, [this] { return mStop || mNumQueued.load(); });
+
+			if (mStop && !mNumQueued.load()) {
+				return;
+			}
+		}
+	}
+
+	/* Blocks until every task of the group has finished, helps with its queued tasks meanwhile. */
+	void Wait(TaskGroup& group)
+	{
+		u32 index = GetWorkerIndex();
+		if (index >= mQueues.size()) {
+			index = 0;
+		}
+
+		while (group.mPending.load())
+		{
+			QueuedTask task;
+			if (PopTask(index, task, &group))
+			{
+				RunTask(task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDoneCondition.wait_for(lock, std::chrono::milliseconds(1), [&group] { return !group.mPending.load(); });
+		}
+	}
+
+	template <typename Fn>
+	void ParallelFor(u32 count, Fn fn)
+	{
+		TaskGroup group;
+
+		for (u32 i = 0; count > i; ++i) {
+			Submit(group, [&fn, i] { fn(i); });
+		}
+
+		Wait(group);
+	}
+};
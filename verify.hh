@@ -0,0 +1,431 @@
+#pragma once
+#include <string>
+#include <vector>
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Structural comparison of two TrueCrowdDataBase resources (-verify).
+///
+///		Both databases are walked once in document order and compared field by field, the
+///		first difference is reported with its path. Only what survives the XML is compared:
+///		arrays with a null offset count as empty, tag bits past the tag list are ignored and
+///		colour tints are compared after the same 0-255 quantization the converter does.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TCDatabaseVerifier
+{
+public:
+	enum ESection
+	{
+		SECTION_ENTITIES,
+		SECTION_TAGS,
+		SECTION_COMPONENT_ENTRIES,
+		SECTION_LODS,
+		SECTION_MODEL_PARTS,
+		SECTION_TEXTURE_SETS,
+		SECTION_COLOUR_TINTS,
+		SECTION_OVERRIDE_PARAMS,
+		NUM_SECTIONS
+	};
+
+	static const char* GetSectionName(u32 section)
+	{
+		static const char* names[NUM_SECTIONS] = { "entities", "tags", "component entries", "LODs", "model parts", "texture sets", "colour tints", "override params" };
+		return names[section];
+	}
+
+	struct PathEntry
+	{
+		const char* mName;
+		u32 mIndex;
+	};
+
+	/* Converters are only used for their layout aware accessors. */
+	TCDatabaseConverter mExpected;
+	TCDatabaseConverter mActual;
+
+	std::vector<PathEntry> mPath;
+	std::string mDifference;
+	u64 mNumCompared[NUM_SECTIONS] = {};
+
+	TCDatabaseVerifier(TrueCrowdDataBase* expected, TrueCrowdDataBase* actual, ETCDatabaseVersion version) : mExpected(expected, version, static_cast<XMLBufferWriter*>(0)), mActual(actual, version, static_cast<XMLBufferWriter*>(0)) {}
+
+	//------------------------------------
+	//	Helpers
+	//------------------------------------
+
+	class ScopedPath
+	{
+	public:
+		TCDatabaseVerifier& mVerifier;
+
+		ScopedPath(TCDatabaseVerifier& verifier, const char* name, u32 index = ~0u) : mVerifier(verifier) { mVerifier.mPath.push_back({ name, index }); }
+
+		~ScopedPath() { mVerifier.mPath.pop_back(); }
+	};
+
+	bool Fail(const char* field, const std::string& expected, const std::string& actual)
+	{
+		mDifference.clear();
+
+		for (auto& entry : mPath)
+		{
+			if (!mDifference.empty()) {
+				mDifference += '/';
+			}
+
+			mDifference += entry.mName;
+
+			if (entry.mIndex != ~0u) {
+				mDifference += '[' + std::to_string(entry.mIndex) + ']';
+			}
+		}
+
+		mDifference += '.';
+		mDifference += field;
+		mDifference += ": expected " + expected + ", got " + actual;
+		return 0;
+	}
+
+	static std::string Hex(u32 value)
+	{
+		char buf[16];
+		return std::string(buf, XMLBufferWriter::FormatHex(buf, value));
+	}
+
+	static std::string Quote(const char* str) { return (str ? '"' + std::string(str) + '"' : "null"); }
+
+	bool Compare(const char* field, u32 expected, u32 actual) { return (expected == actual || Fail(field, std::to_string(expected), std::to_string(actual))); }
+
+	bool CompareSymbol(const char* field, u32 expected, u32 actual) { return (expected == actual || Fail(field, Hex(expected), Hex(actual))); }
+
+	bool CompareString(const char* field, const char* expected, const char* actual)
+	{
+		if (expected == actual || (expected && actual && !strcmp(expected, actual))) {
+			return 1;
+		}
+
+		return Fail(field, Quote(expected), Quote(actual));
+	}
+
+	//------------------------------------
+	//	Definition
+	//------------------------------------
+
+	bool CompareEntityComponent(TrueCrowdDefinition::Entity::EntityComponent* expected, TrueCrowdDefinition::Entity::EntityComponent* actual)
+	{
+		if (!CompareSymbol("mName", expected->mName.mValue, actual->mName.mValue) || !Compare("mResourceIndex", expected->mResourceIndex, actual->mResourceIndex)
+			|| !Compare("mbRequired", expected->mbRequired, actual->mbRequired) || !Compare("mNumBoneUIDs", expected->mNumBoneUIDs, actual->mNumBoneUIDs))
+		{
+			return 0;
+		}
+
+		for (u32 i = 0; expected->mNumBoneUIDs > i; ++i)
+		{
+			ScopedPath path(*this, XTag_BoneUID, i);
+
+			if (!CompareSymbol("mValue", expected->mBoneUID[i].mValue, actual->mBoneUID[i].mValue)) {
+				return 0;
+			}
+		}
+
+		return 1;
+	}
+
+	bool CompareEntities()
+	{
+		ScopedPath path(*this, XTag_Definition);
+
+		u32 numExpected, numActual;
+		auto expected = mExpected.GetEntities(numExpected);
+		auto actual = mActual.GetEntities(numActual);
+
+		if (!Compare("mEntityCount", numExpected, numActual)) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpected > i; ++i)
+		{
+			ScopedPath entityPath(*this, XTag_Entity, i);
+
+			auto expectedEntity = &expected[i];
+			auto actualEntity = &actual[i];
+
+			if (!CompareSymbol("mNameUID", expectedEntity->mNameUID, actualEntity->mNameUID) || !Compare("mComponentCount", expectedEntity->mComponentCount, actualEntity->mComponentCount)
+				|| !Compare("mRequiredComponentCount", expectedEntity->mRequiredComponentCount, actualEntity->mRequiredComponentCount))
+			{
+				return 0;
+			}
+
+			for (u32 j = 0; expectedEntity->mComponentCount > j; ++j)
+			{
+				ScopedPath componentPath(*this, XTag_EntityComponent, j);
+
+				if (!CompareEntityComponent(&expectedEntity->mComponents[j], &actualEntity->mComponents[j])) {
+					return 0;
+				}
+			}
+
+			++mNumCompared[SECTION_ENTITIES];
+		}
+
+		return 1;
+	}
+
+	bool CompareTags()
+	{
+		ScopedPath path(*this, XTag_Tags);
+
+		u32 numExpected, numActual;
+		auto expected = mExpected.GetTags(numExpected);
+		auto actual = mActual.GetTags(numActual);
+
+		if (!Compare("mNumTags", numExpected, numActual)) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpected > i; ++i)
+		{
+			ScopedPath tagPath(*this, XTag_Tag, i);
+
+			if (!CompareSymbol("mValue", expected[i].mValue, actual[i].mValue)) {
+				return 0;
+			}
+
+			++mNumCompared[SECTION_TAGS];
+		}
+
+		return 1;
+	}
+
+	//------------------------------------
+	//	Resource
+	//------------------------------------
+
+	static const char* GetHighResolutionName(TrueCrowdResource* resource)
+	{
+		auto highResResource = resource->mHighResolutionResource.Get();
+		return (highResResource ? highResResource->mName.Get() : 0);
+	}
+
+	bool CompareResource(TrueCrowdResource* expected, TrueCrowdResource* actual)
+	{
+		return CompareString("mName", expected->mName.Get(), actual->mName.Get()) && Compare("mType", expected->mType.mValue, actual->mType.mValue)
+			&& CompareSymbol("mPathSymbol", expected->mPathSymbol, actual->mPathSymbol) && CompareSymbol("mPropSetName", expected->mPropSetName, actual->mPropSetName)
+			&& CompareString("mHighResolutionResource", GetHighResolutionName(expected), GetHighResolutionName(actual));
+	}
+
+	bool CompareLOD(TrueCrowdLOD* expected, TrueCrowdLOD* actual)
+	{
+		auto expectedParts = expected->mModelParts.Get();
+		auto actualParts = actual->mModelParts.Get();
+
+		const u32 numExpected = (expectedParts ? expected->mNumModelParts : 0);
+		if (!Compare("mNumModelParts", numExpected, (actualParts ? actual->mNumModelParts : 0))) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpected > i; ++i)
+		{
+			ScopedPath path(*this, XTag_ModelPart, i);
+
+			auto expectedPart = &expectedParts[i];
+			auto actualPart = &actualParts[i];
+
+			if (!CompareString("mModelName", expectedPart->mModelName.Get(), actualPart->mModelName.Get()) || !CompareSymbol("mModelNameHash", expectedPart->mModelNameHash, actualPart->mModelNameHash)
+				|| !Compare("mIsSkinned", expectedPart->mIsSkinned, actualPart->mIsSkinned) || !Compare("mMorphType", expectedPart->mMorphType.mValue, actualPart->mMorphType.mValue))
+			{
+				return 0;
+			}
+
+			++mNumCompared[SECTION_MODEL_PARTS];
+		}
+
+		++mNumCompared[SECTION_LODS];
+		return 1;
+	}
+
+	static u32 QuantizeTint(f32 value) { return static_cast<u32>(value * 255.f); }
+
+	bool CompareTextureSet(TrueCrowdTextureSet* expected, TrueCrowdTextureSet* actual)
+	{
+		if (!CompareResource(expected, actual)) {
+			return 0;
+		}
+
+		auto expectedTints = expected->mColourTints.Get();
+		auto actualTints = actual->mColourTints.Get();
+
+		const u32 numExpectedTints = (expectedTints ? expected->mNumColorTints : 0);
+		if (!Compare("mNumColorTints", numExpectedTints, (actualTints ? actual->mNumColorTints : 0))) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpectedTints > i; ++i)
+		{
+			ScopedPath path(*this, XTag_ColourTint, i);
+
+			if (!Compare("r", QuantizeTint(expectedTints[i].r), QuantizeTint(actualTints[i].r)) || !Compare("g", QuantizeTint(expectedTints[i].g), QuantizeTint(actualTints[i].g))
+				|| !Compare("b", QuantizeTint(expectedTints[i].b), QuantizeTint(actualTints[i].b)))
+			{
+				return 0;
+			}
+
+			++mNumCompared[SECTION_COLOUR_TINTS];
+		}
+
+		auto expectedParams = expected->mTextureOverrideParams.Get();
+		auto actualParams = actual->mTextureOverrideParams.Get();
+
+		const u32 numExpectedParams = (expectedParams ? expected->mNumTextureOverrideParams : 0);
+		if (!Compare("mNumTextureOverrideParams", numExpectedParams, (actualParams ? actual->mNumTextureOverrideParams : 0))) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpectedParams > i; ++i)
+		{
+			ScopedPath path(*this, XTag_OverrideParam, i);
+
+			auto expectedParam = &expectedParams[i];
+			auto actualParam = &actualParams[i];
+
+			if (!CompareSymbol("mSampler", expectedParam->mSampler.mValue, actualParam->mSampler.mValue) || !CompareSymbol("mTextureNameUID", expectedParam->mTextureNameUID, actualParam->mTextureNameUID)
+				|| !CompareSymbol("mTextureOverrideUID[0]", expectedParam->mTextureOverrideUID[0], actualParam->mTextureOverrideUID[0])
+				|| !CompareSymbol("mTextureOverrideUID[1]", expectedParam->mTextureOverrideUID[1], actualParam->mTextureOverrideUID[1])
+				|| !CompareSymbol("mTextureOverrideUID[2]", expectedParam->mTextureOverrideUID[2], actualParam->mTextureOverrideUID[2]))
+			{
+				return 0;
+			}
+
+			++mNumCompared[SECTION_OVERRIDE_PARAMS];
+		}
+
+		++mNumCompared[SECTION_TEXTURE_SETS];
+		return 1;
+	}
+
+	bool CompareResourceEntry(TrueCrowdDataBase::ResourceEntry* expected, TrueCrowdDataBase::ResourceEntry* actual)
+	{
+		u32 numTags;
+		mExpected.GetTags(numTags);
+
+		for (u32 i = 0; numTags > i; ++i)
+		{
+			if (expected->mTagBitFlag.IsSet(i) != actual->mTagBitFlag.IsSet(i))
+			{
+				ScopedPath path(*this, XTag_Tag, i);
+				return Compare("mTagBitFlag", expected->mTagBitFlag.IsSet(i), actual->mTagBitFlag.IsSet(i));
+			}
+		}
+
+		auto expectedModel = &expected->mResource;
+		auto actualModel = &actual->mResource;
+
+		if (!CompareResource(expectedModel, actualModel) || !CompareSymbol("mComponentTypeSymbolUC", expectedModel->mComponentTypeSymbolUC, actualModel->mComponentTypeSymbolUC)) {
+			return 0;
+		}
+
+		auto expectedLODs = expectedModel->mLODModel.Get();
+		auto actualLODs = actualModel->mLODModel.Get();
+
+		const u32 numExpectedLODs = (expectedLODs ? expectedModel->mNumLODs : 0);
+		if (!Compare("mNumLODs", numExpectedLODs, (actualLODs ? actualModel->mNumLODs : 0))) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpectedLODs > i; ++i)
+		{
+			ScopedPath path(*this, XTag_LOD, i);
+
+			if (!CompareLOD(&expectedLODs[i], &actualLODs[i])) {
+				return 0;
+			}
+		}
+
+		auto expectedTextureSets = expectedModel->mTextureSets.Get();
+		auto actualTextureSets = actualModel->mTextureSets.Get();
+
+		const u32 numExpectedTextureSets = (expectedTextureSets ? expectedModel->mNumTextureSets : 0);
+		if (!Compare("mNumTextureSets", numExpectedTextureSets, (actualTextureSets ? actualModel->mNumTextureSets : 0))) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpectedTextureSets > i; ++i)
+		{
+			ScopedPath path(*this, XTag_TextureSet, i);
+
+			if (!CompareTextureSet(expectedTextureSets[i].Get(), actualTextureSets[i].Get())) {
+				return 0;
+			}
+		}
+
+		return 1;
+	}
+
+	bool CompareComponentEntries()
+	{
+		ScopedPath path(*this, XTag_ComponentEntries);
+
+		u32 numExpected, numActual;
+		auto expected = mExpected.GetComponentEntries(numExpected);
+		auto actual = mActual.GetComponentEntries(numActual);
+
+		if (!expected) {
+			numExpected = 0;
+		}
+
+		if (!actual) {
+			numActual = 0;
+		}
+
+		if (!Compare("mNumComponentEntries", numExpected, numActual)) {
+			return 0;
+		}
+
+		for (u32 i = 0; numExpected > i; ++i)
+		{
+			ScopedPath componentPath(*this, XTag_Component, i);
+
+			if (!CompareString("mName", mExpected.GetComponents()[i].mName, mActual.GetComponents()[i].mName)) {
+				return 0;
+			}
+
+			auto expectedEntries = expected[i].mEntries.Get();
+			auto actualEntries = actual[i].mEntries.Get();
+
+			const u32 numExpectedEntries = (expectedEntries ? expected[i].mNumEntries : 0);
+			if (!Compare("mNumEntries", numExpectedEntries, (actualEntries ? actual[i].mNumEntries : 0))) {
+				return 0;
+			}
+
+			for (u32 j = 0; numExpectedEntries > j; ++j)
+			{
+				ScopedPath resourcePath(*this, XTag_Resource, j);
+
+				if (!CompareResourceEntry(&expectedEntries[j], &actualEntries[j])) {
+					return 0;
+				}
+			}
+
+			++mNumCompared[SECTION_COMPONENT_ENTRIES];
+		}
+
+		return 1;
+	}
+
+	//------------------------------------
+	//	Verify
+	//------------------------------------
+
+	bool Verify() { return CompareEntities() && CompareTags() && CompareComponentEntries(); }
+
+	void PrintSummary()
+	{
+		for (u32 i = 0; NUM_SECTIONS > i; ++i) {
+			qPrintf("  %-20s %llu matched\n", GetSectionName(i), static_cast<unsigned long long>(mNumCompared[i]));
+		}
+	}
+};
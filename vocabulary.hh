@@ -0,0 +1,138 @@
+#pragma once
+#include <cstring>
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Fixed vocabulary of the TCDB XML (XTag_* and XAttr_*) and its perfect hash.
+///
+///		Every tag and attribute name hashes to its own slot of a 64 entry table from its length,
+///		first and last character, so a lookup is one hash and one memcmp instead of a strcmp per
+///		candidate. The table is built at compile time and a collision fails the build, a name
+///		that collides needs new hash factors.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum ETCXMLName
+{
+	XNAME_UNKNOWN,
+
+	// Tags
+
+	XNAME_TCDB,
+	XNAME_DEFINITION,
+	XNAME_ENTITY,
+	XNAME_ENTITY_COMPONENT,
+	XNAME_BONE_UID,
+	XNAME_TAGS,
+	XNAME_TAG,
+	XNAME_COMPONENT_ENTRIES,
+	XNAME_COMPONENT,
+	XNAME_RESOURCE,
+	XNAME_HIGH_RESOLUTION_RESOURCE,
+	XNAME_LOD,
+	XNAME_MODEL_PART,
+	XNAME_TEXTURE_SET,
+	XNAME_COLOUR_TINT,
+	XNAME_OVERRIDE_PARAM,
+
+	// Attributes, XNAME_NAME is the first
+
+	XNAME_NAME,
+	XNAME_NAME_UID,
+	XNAME_RESOURCE_INDEX,
+	XNAME_REQUIRED,
+	XNAME_TYPE,
+	XNAME_IS_SKINNED,
+	XNAME_MORPH_TYPE,
+	XNAME_SAMPLER,
+	XNAME_UID0,
+	XNAME_UID1,
+	XNAME_UID2,
+	XNAME_R,
+	XNAME_G,
+	XNAME_B,
+
+	XNAME_COUNT
+};
+
+class TCXMLVocabulary
+{
+public:
+	static constexpr u32 FirstAttribute = XNAME_NAME;
+	static constexpr u32 NumAttributes = XNAME_COUNT - XNAME_NAME;
+	static constexpr u32 TableSize = 64;
+
+	struct Slot
+	{
+		const char* mStr;
+		u32 mLength;
+		ETCXMLName mName;
+	};
+
+	struct Table
+	{
+		Slot mSlots[TableSize];
+		bool mPerfect;
+	};
+
+	static constexpr u32 Length(const char* str)
+	{
+		u32 len = 0;
+		while (str[len]) {
+			++len;
+		}
+
+		return len;
+	}
+
+	static constexpr u32 Hash(const char* str, u32 len) { return (len + 3 * static_cast<u8>(str[0]) + 50 * static_cast<u8>(str[len - 1])) & (TableSize - 1); }
+
+	static constexpr Table BuildTable()
+	{
+		const char* strs[XNAME_COUNT] = {
+			"",
+			XTag_TCDB, XTag_Definition, XTag_Entity, XTag_EntityComponent, XTag_BoneUID, XTag_Tags, XTag_Tag, XTag_ComponentEntries,
+			XTag_Component, XTag_Resource, XTag_HighResolutionResource, XTag_LOD, XTag_ModelPart, XTag_TextureSet, XTag_ColourTint, XTag_OverrideParam,
+			XAttr_Name, XAttr_NameUID, XAttr_ResourceIndex, XAttr_Required, XAttr_Type, XAttr_IsSkinned, XAttr_MorphType, XAttr_Sampler,
+			XAttr_UID0, XAttr_UID1, XAttr_UID2, "r", "g", "b"
+		};
+
+		Table table = {};
+		table.mPerfect = 1;
+
+		for (u32 i = XNAME_UNKNOWN + 1; XNAME_COUNT > i; ++i)
+		{
+			const u32 len = Length(strs[i]);
+			auto& slot = table.mSlots[Hash(strs[i], len)];
+
+			if (slot.mStr) {
+				table.mPerfect = 0;
+			}
+
+			slot = { strs[i], len, static_cast<ETCXMLName>(i) };
+		}
+
+		return table;
+	}
+
+	static const Table& GetTable()
+	{
+		static constexpr Table table = BuildTable();
+		static_assert(table.mPerfect, "TCDB XML names collide in TCXMLVocabulary::Hash, pick new factors.");
+		return table;
+	}
+
+	static ETCXMLName Find(const char* str, u32 len)
+	{
+		if (!len) {
+			return XNAME_UNKNOWN;
+		}
+
+		auto& slot = GetTable().mSlots[Hash(str, len)];
+		return (slot.mLength == len && !memcmp(slot.mStr, str, len) ? slot.mName : XNAME_UNKNOWN);
+	}
+
+	static bool IsAttribute(ETCXMLName name) { return name >= FirstAttribute; }
+};
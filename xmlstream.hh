@@ -0,0 +1,727 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "platform.hh"
+
+/* SSE2 is part of x64, AVX2 is used when the compiler targets it. Define TCDB_NO_SIMD for the scalar scan. */
+#ifndef TCDB_NO_SIMD
+	#if defined(__AVX2__)
+		#define TCDB_SIMD_AVX2
+		#include <immintrin.h>
+	#endif
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define TCDB_SIMD_SSE2
+		#include <emmintrin.h>
+	#endif
+	#if defined(_MSC_VER) && (defined(TCDB_SIMD_AVX2) || defined(TCDB_SIMD_SSE2))
+		#include <intrin.h>
+	#endif
+#endif
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		Single-pass event (SAX) XML reader.
+///
+///		Reads the input (a file, stdin for - or memory) in fixed size chunks and reports nodes
+///		to a handler without building a document tree. Names and attribute values are decoded
+///		in place and only stay valid for the duration of the callback. End tags have to close
+///		the innermost open element, so the handler never sees a mismatched OnEndNode.
+///
+///		Markup and quotes are found 16 (SSE2) or 32 (AVX2) bytes at a time, the scalar loop
+///		finishes the last bytes of the buffer. Attribute numbers are read by ParseInt and
+///		ParseUInt, which only hand unusual input to strtol/strtoul.
+///
+///		Handler interface:
+///			bool OnBeginNode(const char* name, const XMLEventReader::Attribute* attributes, u32 numAttributes);
+///			bool OnValue(const char* value);
+///			bool OnEndNode(const char* name);
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class XMLEventReader
+{
+public:
+	struct Attribute
+	{
+		const char* mName;
+		const char* mValue;
+		u32 mNameLength;
+	};
+
+	static constexpr size_t ChunkSize = 0x10000;
+	static constexpr u32 MaxAttributes = 32;
+
+	FILE* mFile = 0;
+	const char* mMemory = 0;
+	size_t mMemorySize = 0;
+
+	std::vector<char> mBuffer;
+	size_t mPos = 0;
+	size_t mEnd = 0;
+	bool mEOF = 0;
+
+	u64 mBytesConsumed = 0;
+	std::string mValue;
+
+	/* Names of the open elements, end tags are matched against the innermost one. */
+	std::string mOpenNames;
+	std::vector<u32> mOpenNameOffsets;
+
+	XMLEventReader() {}
+
+	~XMLEventReader()
+	{
+		if (mFile && mFile != stdin) {
+			fclose(mFile);
+		}
+	}
+
+	bool Open(const char* filename)
+	{
+		mFile = (IsStdStream(filename) ? stdin : fopen(filename, "rb"));
+		if (!mFile)
+		{
+			qPrintf("ERROR: Failed to open %s for reading.\n", filename);
+			return 0;
+		}
+
+		return 1;
+	}
+
+	void SetMemory(const void* data, size_t size)
+	{
+		mMemory = static_cast<const char*>(data);
+		mMemorySize = size;
+	}
+
+	//------------------------------------
+	//	Input
+	//------------------------------------
+
+	size_t ReadSource(char* dst, size_t size)
+	{
+		if (mFile) {
+			return fread(dst, 1, size, mFile);
+		}
+
+		if (size > mMemorySize) {
+			size = mMemorySize;
+		}
+
+		qMemCopy(dst, mMemory, size);
+		mMemory += size;
+		mMemorySize -= size;
+		return size;
+	}
+
+	/* Moves the unconsumed bytes to the front and reads the next chunk, grows the buffer when a single token doesn't fit. */
+	bool Fill()
+	{
+		if (mEOF) {
+			return 0;
+		}
+
+		if (mPos)
+		{
+			mBytesConsumed += mPos;
+			memmove(mBuffer.data(), &mBuffer[mPos], mEnd - mPos);
+			mEnd -= mPos;
+			mPos = 0;
+		}
+
+		if (mBuffer.size() < mEnd + ChunkSize + 1) {
+			mBuffer.resize(mEnd + ChunkSize + 1);
+		}
+
+		const size_t numRead = ReadSource(&mBuffer[mEnd], ChunkSize);
+		mEnd += numRead;
+		mBuffer[mEnd] = 0;
+
+		if (!numRead) {
+			mEOF = 1;
+		}
+
+		return numRead != 0;
+	}
+
+	//------------------------------------
+	//	Scanning
+	//------------------------------------
+
+	static u32 CountTrailingZeros(u32 mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<u32>(index);
+#else
+		return static_cast<u32>(__builtin_ctz(mask));
+#endif
+	}
+
+	/* First of a, b or c in [str, end), end if there is none. */
+	static const char* ScanAny(const char* str, const char* end, char a, char b, char c)
+	{
+#ifdef TCDB_SIMD_AVX2
+		const __m256i a32 = _mm256_set1_epi8(a);
+		const __m256i b32 = _mm256_set1_epi8(b);
+		const __m256i c32 = _mm256_set1_epi8(c);
+
+		for (; end - str >= 32; str += 32)
+		{
+			const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str));
+			const __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, a32), _mm256_cmpeq_epi8(bytes, b32)), _mm256_cmpeq_epi8(bytes, c32));
+
+			if (const u32 mask = static_cast<u32>(_mm256_movemask_epi8(match))) {
+				return str + CountTrailingZeros(mask);
+			}
+		}
+#endif
+
+#ifdef TCDB_SIMD_SSE2
+		const __m128i a16 = _mm_set1_epi8(a);
+		const __m128i b16 = _mm_set1_epi8(b);
+		const __m128i c16 = _mm_set1_epi8(c);
+
+		for (; end - str >= 16; str += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+			const __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, a16), _mm_cmpeq_epi8(bytes, b16)), _mm_cmpeq_epi8(bytes, c16));
+
+			if (const u32 mask = static_cast<u32>(_mm_movemask_epi8(match))) {
+				return str + CountTrailingZeros(mask);
+			}
+		}
+#endif
+
+		for (; end > str; ++str)
+		{
+			if (*str == a || *str == b || *str == c) {
+				return str;
+			}
+		}
+
+		return end;
+	}
+
+	static const char* Scan(const char* str, const char* end, char c) { return ScanAny(str, end, c, c, c); }
+
+	/* Returns offset (relative to mPos) of the sequence, fills more input as required. */
+	size_t Find(size_t offset, const char* seq, size_t seqLen)
+	{
+		for (;;)
+		{
+			/* Candidates start before mEnd - seqLen + 1, so the whole sequence is in the buffer. */
+			const char* begin = mBuffer.data();
+			const char* last = begin + (mEnd + 1 >= seqLen ? mEnd + 1 - seqLen : 0);
+
+			for (const char* it = begin + mPos + offset; last > it; ++it)
+			{
+				it = Scan(it, last, seq[0]);
+				if (it == last) {
+					break;
+				}
+
+				if (!memcmp(it, seq, seqLen)) {
+					return static_cast<size_t>(it - begin) - mPos;
+				}
+			}
+
+			offset = (mEnd - mPos >= seqLen ? mEnd - mPos - seqLen + 1 : 0);
+			if (!Fill()) {
+				return std::string::npos;
+			}
+		}
+	}
+
+	/* Returns offset (relative to mPos) of the '>' closing a start tag, quoted values may contain '>'. */
+	size_t FindTagEnd()
+	{
+		size_t offset = 1;
+		char quote = 0;
+
+		for (;;)
+		{
+			const char* begin = mBuffer.data();
+			const char* end = begin + mEnd;
+
+			for (const char* it = begin + mPos + offset; end > it; ++it)
+			{
+				it = (quote ? Scan(it, end, quote) : ScanAny(it, end, '>', '"', '\''));
+				if (it == end) {
+					break;
+				}
+
+				if (quote) {
+					quote = 0;
+				}
+				else if (*it == '>') {
+					return static_cast<size_t>(it - begin) - mPos;
+				}
+				else {
+					quote = *it;
+				}
+			}
+
+			offset = mEnd - mPos;
+			if (!Fill()) {
+				return std::string::npos;
+			}
+		}
+	}
+
+	bool Available(size_t len)
+	{
+		while (mEnd - mPos < len)
+		{
+			if (!Fill()) {
+				return 0;
+			}
+		}
+
+		return 1;
+	}
+
+	bool StartsWith(const char* str, size_t len) { return Available(len) && !memcmp(&mBuffer[mPos], str, len); }
+
+	//------------------------------------
+	//	Decoding
+	//------------------------------------
+
+	static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+	static char* EncodeUTF8(char* dst, u32 cp)
+	{
+		if (cp < 0x80) {
+			*dst++ = static_cast<char>(cp);
+		}
+		else if (cp < 0x800)
+		{
+			*dst++ = static_cast<char>(0xC0 | (cp >> 6));
+			*dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000)
+		{
+			*dst++ = static_cast<char>(0xE0 | (cp >> 12));
+			*dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			*dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else
+		{
+			*dst++ = static_cast<char>(0xF0 | (cp >> 18));
+			*dst++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			*dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			*dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+
+		return dst;
+	}
+
+	/* Decodes entity references in place (output is never longer than input), returns the new end. */
+	static char* DecodeEntities(char* str, char* end)
+	{
+		/* Most values have no references, only the part from the first '&' is rewritten. */
+		auto amp = static_cast<char*>(memchr(str, '&', static_cast<size_t>(end - str)));
+		if (!amp)
+		{
+			*end = 0;
+			return end;
+		}
+
+		char* dst = amp;
+		for (char* src = amp; end > src;)
+		{
+			if (*src != '&')
+			{
+				*dst++ = *src++;
+				continue;
+			}
+
+			char* semi = src + 1;
+			while (end > semi && *semi != ';' && semi - src < 12) {
+				++semi;
+			}
+
+			if (semi == end || *semi != ';')
+			{
+				*dst++ = *src++;
+				continue;
+			}
+
+			const size_t len = semi - src - 1;
+			const char* ent = src + 1;
+
+			if (len == 3 && !memcmp(ent, "amp", 3)) {
+				*dst++ = '&';
+			}
+			else if (len == 2 && !memcmp(ent, "lt", 2)) {
+				*dst++ = '<';
+			}
+			else if (len == 2 && !memcmp(ent, "gt", 2)) {
+				*dst++ = '>';
+			}
+			else if (len == 4 && !memcmp(ent, "quot", 4)) {
+				*dst++ = '"';
+			}
+			else if (len == 4 && !memcmp(ent, "apos", 4)) {
+				*dst++ = '\'';
+			}
+			else if (len > 1 && *ent == '#')
+			{
+				const bool hex = (ent[1] == 'x' || ent[1] == 'X');
+				const u32 cp = static_cast<u32>(strtoul(&ent[hex ? 2 : 1], 0, hex ? 16 : 10));
+				dst = EncodeUTF8(dst, cp);
+			}
+			else
+			{
+				qMemCopy(dst, src, len + 2);
+				dst += len + 2;
+			}
+
+			src = semi + 1;
+		}
+
+		*dst = 0;
+		return dst;
+	}
+
+	//------------------------------------
+	//	Parse
+	//------------------------------------
+
+	bool Error(const char* reason)
+	{
+		qPrintf("ERROR: XML %s near byte %llu.\n", reason, static_cast<unsigned long long>(mBytesConsumed + mPos));
+		return 0;
+	}
+
+	template <typename Handler>
+	bool ParseValue(Handler& handler, size_t len)
+	{
+		char* begin = &mBuffer[mPos];
+		char* end = begin + len;
+
+		while (end > begin && IsSpace(*begin)) {
+			++begin;
+		}
+
+		while (end > begin && IsSpace(end[-1])) {
+			--end;
+		}
+
+		if (begin == end) {
+			return 1;
+		}
+
+		mValue.assign(begin, end);
+		mValue.resize(DecodeEntities(&mValue[0], &mValue[0] + mValue.size()) - &mValue[0]);
+
+		return handler.OnValue(mValue.c_str());
+	}
+
+	template <typename Handler>
+	bool ParseStartTag(Handler& handler, size_t tagEnd)
+	{
+		char* str = &mBuffer[mPos + 1];
+		char* end = &mBuffer[mPos + tagEnd];
+
+		const bool selfClosing = (end > str && end[-1] == '/');
+		if (selfClosing) {
+			--end;
+		}
+
+		char* name = str;
+		while (end > str && !IsSpace(*str)) {
+			++str;
+		}
+
+		if (str == name) {
+			return Error("start tag without a name");
+		}
+
+		char* nameEnd = str;
+
+		Attribute attributes[MaxAttributes];
+		u32 numAttributes = 0;
+
+		for (;;)
+		{
+			while (end > str && IsSpace(*str)) {
+				++str;
+			}
+
+			if (str == end) {
+				break;
+			}
+
+			char* attrName = str;
+			while (end > str && *str != '=' && !IsSpace(*str)) {
+				++str;
+			}
+
+			char* attrNameEnd = str;
+			while (end > str && IsSpace(*str)) {
+				++str;
+			}
+
+			if (str == end || *str != '=') {
+				return Error("attribute without a value");
+			}
+
+			++str;
+			while (end > str && IsSpace(*str)) {
+				++str;
+			}
+
+			const char quote = (end > str ? *str : 0);
+			if (quote != '"' && quote != '\'') {
+				return Error("unquoted attribute value");
+			}
+
+			char* value = ++str;
+			str = const_cast<char*>(Scan(str, end, quote));
+
+			if (str == end) {
+				return Error("unterminated attribute value");
+			}
+
+			char* valueEnd = str++;
+
+			if (numAttributes == MaxAttributes) {
+				return Error("node with too many attributes");
+			}
+
+			*attrNameEnd = 0;
+			DecodeEntities(value, valueEnd);
+			attributes[numAttributes++] = { attrName, value, static_cast<u32>(attrNameEnd - attrName) };
+		}
+
+		*nameEnd = 0;
+
+		if (!handler.OnBeginNode(name, attributes, numAttributes)) {
+			return 0;
+		}
+
+		if (selfClosing) {
+			return handler.OnEndNode(name);
+		}
+
+		mOpenNameOffsets.push_back(static_cast<u32>(mOpenNames.size()));
+		mOpenNames.append(name, nameEnd - name);
+		return 1;
+	}
+
+	template <typename Handler>
+	bool Parse(Handler& handler)
+	{
+		mOpenNames.clear();
+		mOpenNameOffsets.clear();
+
+		for (;;)
+		{
+			// Text up to the next markup.
+
+			size_t lt = Find(0, "<", 1);
+			if (lt == std::string::npos)
+			{
+				if (!mOpenNameOffsets.empty()) {
+					return Error("unexpected end of input");
+				}
+
+				return 1;
+			}
+
+			if (lt && !mOpenNameOffsets.empty() && !ParseValue(handler, lt)) {
+				return 0;
+			}
+
+			mPos += lt;
+
+			// Markup
+
+			if (StartsWith("<!--", 4))
+			{
+				size_t end = Find(4, "-->", 3);
+				if (end == std::string::npos) {
+					return Error("unterminated comment");
+				}
+
+				mPos += end + 3;
+			}
+			else if (StartsWith("<![CDATA[", 9))
+			{
+				size_t end = Find(9, "]]>", 3);
+				if (end == std::string::npos) {
+					return Error("unterminated CDATA section");
+				}
+
+				mValue.assign(&mBuffer[mPos + 9], end - 9);
+				if (!handler.OnValue(mValue.c_str())) {
+					return 0;
+				}
+
+				mPos += end + 3;
+			}
+			else if (StartsWith("<?", 2) || StartsWith("<!", 2))
+			{
+				size_t end = Find(2, ">", 1);
+				if (end == std::string::npos) {
+					return Error("unterminated declaration");
+				}
+
+				mPos += end + 1;
+			}
+			else if (StartsWith("</", 2))
+			{
+				size_t end = Find(2, ">", 1);
+				if (end == std::string::npos) {
+					return Error("unterminated end tag");
+				}
+
+				if (mOpenNameOffsets.empty()) {
+					return Error("unexpected end tag");
+				}
+
+				char* name = &mBuffer[mPos + 2];
+				char* nameEnd = &mBuffer[mPos + end];
+				while (nameEnd > name && IsSpace(nameEnd[-1])) {
+					--nameEnd;
+				}
+				*nameEnd = 0;
+
+				const u32 openName = mOpenNameOffsets.back();
+				if (mOpenNames.compare(openName, std::string::npos, name, nameEnd - name)) {
+					return Error("mismatched end tag");
+				}
+
+				if (!handler.OnEndNode(name)) {
+					return 0;
+				}
+
+				mOpenNames.resize(openName);
+				mOpenNameOffsets.pop_back();
+				mPos += end + 1;
+			}
+			else
+			{
+				size_t end = FindTagEnd();
+				if (end == std::string::npos) {
+					return Error("unterminated start tag");
+				}
+
+				if (!ParseStartTag(handler, end)) {
+					return 0;
+				}
+
+				mPos += end + 1;
+			}
+		}
+	}
+
+	//------------------------------------
+	//	Attribute Helpers
+	//------------------------------------
+
+	static const char* GetAttribute(const Attribute* attributes, u32 numAttributes, const char* name)
+	{
+		for (u32 i = 0; numAttributes > i; ++i)
+		{
+			if (!strcmp(attributes[i].mName, name)) {
+				return attributes[i].mValue;
+			}
+		}
+
+		return 0;
+	}
+
+	static int GetAttribute(const Attribute* attributes, u32 numAttributes, const char* name, int defaultValue)
+	{
+		auto value = GetAttribute(attributes, numAttributes, name);
+		return (value ? ParseInt(value) : defaultValue);
+	}
+
+	static u32 GetAttribute(const Attribute* attributes, u32 numAttributes, const char* name, u32 defaultValue)
+	{
+		auto value = GetAttribute(attributes, numAttributes, name);
+		return (value ? ParseUInt(value) : defaultValue);
+	}
+
+	/* Same result as static_cast<int>(strtol(str, 0, 10)). */
+	static int ParseInt(const char* str)
+	{
+		const bool negative = (*str == '-');
+		const char* digits = str + negative;
+
+		u64 value = 0;
+		u32 numDigits = 0;
+
+		for (; digits[numDigits] >= '0' && digits[numDigits] <= '9'; ++numDigits)
+		{
+			if (numDigits == 18) {
+				return static_cast<int>(strtol(str, 0, 10));
+			}
+
+			value = value * 10 + static_cast<u32>(digits[numDigits] - '0');
+		}
+
+		/* strtol saturates where long is 32 bits, leave everything outside of int to it. */
+		if (!numDigits || value > 0x7FFFFFFFull + negative) {
+			return static_cast<int>(strtol(str, 0, 10));
+		}
+
+		return static_cast<int>(negative ? -static_cast<s64>(value) : static_cast<s64>(value));
+	}
+
+	static u32 HexDigit(char c)
+	{
+		if (c >= '0' && c <= '9') {
+			return static_cast<u32>(c - '0');
+		}
+
+		if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+			return static_cast<u32>((c | 0x20) - 'a' + 10);
+		}
+
+		return ~0u;
+	}
+
+	/* Same result as static_cast<u32>(strtoul(str, 0, 0)), decimal and 0x hex within u32 are read directly. */
+	static u32 ParseUInt(const char* str)
+	{
+		u64 value = 0;
+
+		if (str[0] == '0' && (str[1] | 0x20) == 'x' && HexDigit(str[2]) != ~0u)
+		{
+			u32 numDigits = 0;
+			for (u32 digit; (digit = HexDigit(str[2 + numDigits])) != ~0u; ++numDigits)
+			{
+				if (numDigits == 15) {
+					return static_cast<u32>(strtoul(str, 0, 0));
+				}
+
+				value = (value << 4) | digit;
+			}
+
+			return (value > 0xFFFFFFFFull ? static_cast<u32>(strtoul(str, 0, 0)) : static_cast<u32>(value));
+		}
+
+		/* A leading 0 is octal to strtoul. */
+		if (str[0] < '1' || str[0] > '9') {
+			return (str[0] == '0' && (str[1] < '0' || str[1] > '9') ? 0 : static_cast<u32>(strtoul(str, 0, 0)));
+		}
+
+		for (u32 numDigits = 0; str[numDigits] >= '0' && str[numDigits] <= '9'; ++numDigits)
+		{
+			if (numDigits == 19) {
+				return static_cast<u32>(strtoul(str, 0, 0));
+			}
+
+			value = value * 10 + static_cast<u32>(str[numDigits] - '0');
+		}
+
+		return (value > 0xFFFFFFFFull ? static_cast<u32>(strtoul(str, 0, 0)) : static_cast<u32>(value));
+	}
+};
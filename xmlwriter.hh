@@ -0,0 +1,724 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "platform.hh"
+
+using namespace UFG;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///		XML writer that formats into a memory buffer.
+///
+///		Same call pattern as SimpleXML::XMLWriter (BeginNode, AddAttribute, AddValue, EndNode),
+///		nodes are indented with tabs and empty nodes are self-closed. When a file is attached
+///		the buffer is flushed to it whenever it grows past the flush size, otherwise the whole
+///		output stays in memory and can be appended to another writer. The filename - attaches
+///		the output stream (stdout) instead of a file.
+///
+///		With async writes the calls are recorded and double buffered: a full recording is
+///		swapped with the back recording and replayed by a writer thread into a writer that
+///		owns the file, so the bytes come from the same formatting as without async writes.
+///		The exporting thread only waits if the previous replay has not finished yet. Compact
+///		output leaves out the indentation.
+///
+///		OpenEngineWriter passes every call on to SimpleXML::XMLWriter instead, so converted
+///		files keep the engine's escaping, number formatting and layout. The engine writer only
+///		takes filenames, for - it writes a temporary file that is copied to the stream on Close. A recording writer
+///		only keeps its calls, AppendWriter replays them into another writer so output built
+///		on several threads still goes through that writer's formatting.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Writer calls kept for a replay, names have to outlive the recording (they are the XTag_ and XAttr_ literals), text is copied. */
+struct XMLRecording
+{
+	enum EOp : u8
+	{
+		OP_BEGIN_NODE,
+		OP_END_NODE,
+		OP_ATTRIBUTE,
+		OP_ATTRIBUTE_INT,
+		OP_ATTRIBUTE_U32,
+		OP_ATTRIBUTE_BOOL,
+		OP_VALUE,
+		OP_COMMENT
+	};
+
+	static constexpr u32 NullText = ~0u;
+
+	struct Op
+	{
+		const char* mName;
+		u32 mValue;		// Number, or offset of the null terminated text in mText
+		EOp mOp;
+	};
+
+	std::vector<Op> mOps;
+	std::vector<char> mText;
+
+	void Add(EOp op, const char* name, u32 value = 0) { mOps.push_back({ name, value, op }); }
+
+	void AddText(EOp op, const char* name, const char* str, size_t len)
+	{
+		mOps.push_back({ name, static_cast<u32>(mText.size()), op });
+		mText.insert(mText.end(), str, str + len);
+		mText.push_back(0);
+	}
+
+	void AddText(EOp op, const char* name, const char* str)
+	{
+		if (str) {
+			AddText(op, name, str, strlen(str));
+		}
+		else {
+			Add(op, name, NullText);
+		}
+	}
+
+	/* Bytes held, compared with the flush size of async writes. */
+	size_t GetSize() const { return mOps.size() * sizeof(Op) + mText.size(); }
+
+	const char* GetText(const Op& op) const { return (op.mValue == NullText ? 0 : &mText[op.mValue]); }
+
+	void Clear()
+	{
+		mOps.clear();
+		mText.clear();
+	}
+
+	/* Makes the same calls on writer, text values arrive as const char* like in the engine writer API. */
+	template <typename Writer>
+	void Replay(Writer& writer) const
+	{
+		for (auto& op : mOps)
+		{
+			switch (op.mOp)
+			{
+			case OP_BEGIN_NODE:
+				writer.BeginNode(op.mName);
+				break;
+			case OP_END_NODE:
+				writer.EndNode(op.mName);
+				break;
+			case OP_ATTRIBUTE:
+				writer.AddAttribute(op.mName, GetText(op));
+				break;
+			case OP_ATTRIBUTE_INT:
+				writer.AddAttribute(op.mName, static_cast<int>(op.mValue));
+				break;
+			case OP_ATTRIBUTE_U32:
+				writer.AddAttribute(op.mName, op.mValue);
+				break;
+			case OP_ATTRIBUTE_BOOL:
+				writer.AddAttribute(op.mName, op.mValue != 0);
+				break;
+			case OP_VALUE:
+				writer.AddValue(GetText(op));
+				break;
+			case OP_COMMENT:
+				writer.AddComment(std::string_view(GetText(op)));
+				break;
+			}
+		}
+	}
+};
+
+class XMLBufferWriter
+{
+public:
+	std::vector<char> mBuffer;
+	size_t mFlushSize = 0x8000;
+	qFile* mFile = 0;
+	FILE* mStream = 0;
+
+	u32 mDepth = 0;
+	bool mOpenTag = 0;
+	bool mHasValue = 0;
+	bool mCompact = 0;
+
+	u64 mNumNodes = 0;
+	u64 mNumBytesWritten = 0;
+
+	/* Time the exporting thread spent in writes, with async writes the time it waited for the writer thread. */
+	std::chrono::steady_clock::duration mFlushTime = {};
+
+	/* Async writes, mBackRecording and mAsyncTarget are owned by the writer thread while mWritePending is set. */
+	bool mAsync = 0;
+	XMLRecording mBackRecording;
+	std::unique_ptr<XMLBufferWriter> mAsyncTarget;
+	std::thread mWriteThread;
+	std::mutex mWriteMutex;
+	std::condition_variable mWriteCondition;
+	bool mWritePending = 0;
+	bool mStopWriting = 0;
+
+	/* Calls go to mRecording instead of any output. */
+	bool mRecord = 0;
+	XMLRecording mRecording;
+
+	/* Set by OpenEngineWriter, mEngineValue null terminates string views for it. */
+	SimpleXML::XMLWriter* mEngineWriter = 0;
+	std::string mEngineFilename;
+	bool mEngineToStream = 0;
+	std::string mEngineValue;
+
+	XMLBufferWriter(u32 depth = 0, bool compact = 0) : mDepth(depth), mCompact(compact) {}
+
+	~XMLBufferWriter() { Close(); }
+
+	bool Open(const char* filename, size_t flushSize = 0x8000, bool async = 0)
+	{
+		if (async) {
+			return OpenAsync(filename, flushSize, 0);
+		}
+
+		if (IsStdStream(filename)) {
+			mStream = GetOutputStream();
+		}
+		else {
+			mFile = qOpen(filename, QACCESS_WRITE);
+		}
+
+		if (!IsAttached())
+		{
+			qPrintf("ERROR: Failed to open %s for writing.\n", filename);
+			return 0;
+		}
+
+		mFlushSize = flushSize;
+		mBuffer.reserve(flushSize + 0x1000);
+		return 1;
+	}
+
+	bool OpenEngineWriter(const char* filename, size_t bufferSize = 0x8000, bool async = 0)
+	{
+		if (async) {
+			return OpenAsync(filename, bufferSize, 1);
+		}
+
+		mEngineToStream = IsStdStream(filename);
+		mEngineFilename = (mEngineToStream ? GetTempFilename(".xml") : std::string(filename));
+
+		mEngineWriter = SimpleXML::XMLWriter::Create(mEngineFilename.c_str(), 0, static_cast<int>(bufferSize));
+		if (!mEngineWriter)
+		{
+			qPrintf("ERROR: Failed to open %s for writing.\n", mEngineFilename.c_str());
+			return 0;
+		}
+
+		return 1;
+	}
+
+	/* Records on the calling thread, the writer thread replays full recordings into mAsyncTarget. */
+	bool OpenAsync(const char* filename, size_t flushSize, bool engineWriter)
+	{
+		mAsyncTarget.reset(new XMLBufferWriter(0, mCompact));
+		if (!(engineWriter ? mAsyncTarget->OpenEngineWriter(filename, flushSize) : mAsyncTarget->Open(filename, flushSize)))
+		{
+			mAsyncTarget.reset();
+			return 0;
+		}
+
+		mFlushSize = flushSize;
+		mRecord = 1;
+		mAsync = 1;
+		mStopWriting = 0;
+		mWriteThread = std::thread([this]() { WriteThread(); });
+		return 1;
+	}
+
+	bool IsAttached() const { return mFile || mStream; }
+
+	void Close()
+	{
+		if (mAsync)
+		{
+			Flush();
+
+			{
+				std::lock_guard<std::mutex> lock(mWriteMutex);
+				mStopWriting = 1;
+			}
+
+			mWriteCondition.notify_all();
+			mWriteThread.join();
+
+			mAsyncTarget->Close();
+			mNumBytesWritten = mAsyncTarget->mNumBytesWritten;
+			mAsyncTarget.reset();
+
+			mAsync = 0;
+			mRecord = 0;
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			auto start = std::chrono::steady_clock::now();
+			SimpleXML::XMLWriter::Close(mEngineWriter);
+			mEngineWriter = 0;
+			mFlushTime += std::chrono::steady_clock::now() - start;
+
+			std::error_code ec;
+			const auto size = std::filesystem::file_size(mEngineFilename, ec);
+			mNumBytesWritten = (ec ? 0 : static_cast<u64>(size));
+
+			if (mEngineToStream)
+			{
+				if (!CopyFileToStream(mEngineFilename.c_str(), GetOutputStream())) {
+					qPrintf("ERROR: Failed to copy %s to the output stream.\n", mEngineFilename.c_str());
+				}
+
+				std::filesystem::remove(mEngineFilename, ec);
+				mEngineToStream = 0;
+			}
+
+			return;
+		}
+
+		if (!IsAttached()) {
+			return;
+		}
+
+		Flush();
+
+		if (mFile) {
+			qClose(mFile);
+		}
+		else {
+			fflush(mStream);
+		}
+
+		mFile = 0;
+		mStream = 0;
+	}
+
+	void Write(const std::vector<char>& buffer)
+	{
+		if (mFile) {
+			qWriteString(mFile, buffer.data(), static_cast<s64>(buffer.size()));
+		}
+		else {
+			fwrite(buffer.data(), 1, buffer.size(), mStream);
+		}
+
+		mNumBytesWritten += buffer.size();
+	}
+
+	void Flush()
+	{
+		if (mAsync)
+		{
+			if (mRecording.mOps.empty()) {
+				return;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+
+			std::unique_lock<std::mutex> lock(mWriteMutex);
+			mWriteCondition.wait(lock, [this]() { return !mWritePending; });
+
+			std::swap(mRecording, mBackRecording);
+			mWritePending = 1;
+
+			lock.unlock();
+			mWriteCondition.notify_all();
+
+			mFlushTime += std::chrono::steady_clock::now() - start;
+			return;
+		}
+
+		if (IsAttached() && !mBuffer.empty())
+		{
+			auto start = std::chrono::steady_clock::now();
+			Write(mBuffer);
+			mFlushTime += std::chrono::steady_clock::now() - start;
+		}
+
+		mBuffer.clear();
+	}
+
+	void WriteThread()
+	{
+		std::unique_lock<std::mutex> lock(mWriteMutex);
+
+		for (;;)
+		{
+			mWriteCondition.wait(lock, [this]() { return mWritePending || mStopWriting; });
+			if (!mWritePending) {
+				break;
+			}
+
+			lock.unlock();
+			mBackRecording.Replay(*mAsyncTarget);
+			mBackRecording.Clear();
+			lock.lock();
+
+			mWritePending = 0;
+			mWriteCondition.notify_all();
+		}
+	}
+
+	//------------------------------------
+	//	Formatting
+	//------------------------------------
+
+	/* Writes the decimal digits of value to buf (at least 10 bytes), returns the length. */
+	static u32 FormatDecimal(char* buf, u32 value)
+	{
+		char tmp[10];
+		u32 len = 0;
+
+		do
+		{
+			tmp[len++] = static_cast<char>('0' + value % 10);
+			value /= 10;
+		} while (value);
+
+		for (u32 i = 0; len > i; ++i) {
+			buf[i] = tmp[len - i - 1];
+		}
+
+		return len;
+	}
+
+	/* Writes value to buf (at least 11 bytes), returns the length. */
+	static u32 FormatDecimal(char* buf, int value)
+	{
+		if (value >= 0) {
+			return FormatDecimal(buf, static_cast<u32>(value));
+		}
+
+		buf[0] = '-';
+		return FormatDecimal(&buf[1], 0u - static_cast<u32>(value)) + 1;
+	}
+
+	/* Writes value as 0x prefixed uppercase hex without padding (same as "0x%X") to buf (at least 10 bytes), returns the length. */
+	static u32 FormatHex(char* buf, u32 value)
+	{
+		static const char digits[] = "0123456789ABCDEF";
+
+		buf[0] = '0';
+		buf[1] = 'x';
+
+		u32 numDigits = 1;
+		while (numDigits < 8 && (value >> (numDigits * 4))) {
+			++numDigits;
+		}
+
+		for (u32 i = 0; numDigits > i; ++i) {
+			buf[2 + i] = digits[(value >> ((numDigits - i - 1) * 4)) & 0xF];
+		}
+
+		return numDigits + 2;
+	}
+
+	//------------------------------------
+	//	Output
+	//------------------------------------
+
+	void Append(const char* str, size_t len) { mBuffer.insert(mBuffer.end(), str, str + len); }
+
+	void Append(const char* str) { Append(str, strlen(str)); }
+
+	void Append(char c) { mBuffer.push_back(c); }
+
+	void AppendEscaped(std::string_view str)
+	{
+		const char* begin = str.data();
+		const char* end = begin + str.size();
+
+		for (const char* it = begin; end > it; ++it)
+		{
+			const char c = *it;
+			if (c != '&' && c != '<' && c != '>' && c != '"') {
+				continue;
+			}
+
+			Append(begin, it - begin);
+			begin = it + 1;
+
+			switch (c)
+			{
+			case '&':
+				Append("&amp;", 5);
+				break;
+			case '<':
+				Append("&lt;", 4);
+				break;
+			case '>':
+				Append("&gt;", 4);
+				break;
+			case '"':
+				Append("&quot;", 6);
+				break;
+			}
+		}
+
+		Append(begin, end - begin);
+	}
+
+	void AppendEscaped(const char* str)
+	{
+		if (str) {
+			AppendEscaped(std::string_view(str));
+		}
+	}
+
+	void AppendIndent()
+	{
+		if (mCompact) {
+			return;
+		}
+
+		for (u32 i = 0; mDepth > i; ++i) {
+			Append('\t');
+		}
+	}
+
+	void ClosePendingTag()
+	{
+		if (mOpenTag)
+		{
+			Append(">\n", 2);
+			mOpenTag = 0;
+		}
+	}
+
+	void FlushIfFull()
+	{
+		if (mAsync ? mRecording.GetSize() >= mFlushSize : IsAttached() && mBuffer.size() >= mFlushSize) {
+			Flush();
+		}
+	}
+
+	/* Replays the calls of a recording writer at this writer's current depth. */
+	void AppendWriter(const XMLBufferWriter& writer) { writer.mRecording.Replay(*this); }
+
+	//------------------------------------
+	//	Nodes
+	//------------------------------------
+
+	void BeginNode(const char* name)
+	{
+		++mNumNodes;
+
+		if (mRecord)
+		{
+			mRecording.Add(XMLRecording::OP_BEGIN_NODE, name);
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineWriter->BeginNode(name);
+			return;
+		}
+
+		ClosePendingTag();
+		AppendIndent();
+		Append('<');
+		Append(name);
+
+		mOpenTag = 1;
+		mHasValue = 0;
+		++mDepth;
+	}
+
+	void EndNode(const char* name)
+	{
+		if (mRecord)
+		{
+			mRecording.Add(XMLRecording::OP_END_NODE, name);
+			FlushIfFull();
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineWriter->EndNode(name);
+			return;
+		}
+
+		--mDepth;
+
+		if (mOpenTag)
+		{
+			Append("/>\n", 3);
+			mOpenTag = 0;
+		}
+		else
+		{
+			if (!mHasValue) {
+				AppendIndent();
+			}
+
+			Append("</", 2);
+			Append(name);
+			Append(">\n", 2);
+		}
+
+		mHasValue = 0;
+		FlushIfFull();
+	}
+
+	void AddAttribute(const char* name, std::string_view value)
+	{
+		if (mRecord)
+		{
+			mRecording.AddText(XMLRecording::OP_ATTRIBUTE, name, value.data(), value.size());
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineValue.assign(value.data(), value.size());
+			mEngineWriter->AddAttribute(name, mEngineValue.c_str());
+			return;
+		}
+
+		Append(' ');
+		Append(name);
+		Append("=\"", 2);
+		AppendEscaped(value);
+		Append('"');
+	}
+
+	void AddAttribute(const char* name, const char* value)
+	{
+		if (mRecord) {
+			mRecording.AddText(XMLRecording::OP_ATTRIBUTE, name, value);
+		}
+		else if (mEngineWriter) {
+			mEngineWriter->AddAttribute(name, value);
+		}
+		else {
+			AddAttribute(name, std::string_view(value ? value : ""));
+		}
+	}
+
+	void AddAttribute(const char* name, const qString& value) { AddAttribute(name, value.mData); }
+
+	void AddAttribute(const char* name, int value)
+	{
+		if (mRecord)
+		{
+			mRecording.Add(XMLRecording::OP_ATTRIBUTE_INT, name, static_cast<u32>(value));
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineWriter->AddAttribute(name, value);
+			return;
+		}
+
+		char buf[12];
+		AddAttribute(name, std::string_view(buf, FormatDecimal(buf, value)));
+	}
+
+	void AddAttribute(const char* name, u32 value)
+	{
+		if (mRecord)
+		{
+			mRecording.Add(XMLRecording::OP_ATTRIBUTE_U32, name, value);
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineWriter->AddAttribute(name, value);
+			return;
+		}
+
+		char buf[12];
+		AddAttribute(name, std::string_view(buf, FormatDecimal(buf, value)));
+	}
+
+	/* Bools are formatted as 0/1, the engine writer gets them as they are. */
+	void AddAttribute(const char* name, bool value)
+	{
+		if (mRecord) {
+			mRecording.Add(XMLRecording::OP_ATTRIBUTE_BOOL, name, value);
+		}
+		else if (mEngineWriter) {
+			mEngineWriter->AddAttribute(name, value);
+		}
+		else {
+			AddAttribute(name, static_cast<u32>(value));
+		}
+	}
+
+	void AddValue(std::string_view value)
+	{
+		if (mRecord)
+		{
+			mRecording.AddText(XMLRecording::OP_VALUE, 0, value.data(), value.size());
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineValue.assign(value.data(), value.size());
+			mEngineWriter->AddValue(mEngineValue.c_str());
+			return;
+		}
+
+		if (mOpenTag)
+		{
+			Append('>');
+			mOpenTag = 0;
+		}
+
+		AppendEscaped(value);
+		mHasValue = 1;
+	}
+
+	void AddValue(const char* value)
+	{
+		if (mRecord) {
+			mRecording.AddText(XMLRecording::OP_VALUE, 0, value);
+		}
+		else if (mEngineWriter) {
+			mEngineWriter->AddValue(value);
+		}
+		else {
+			AddValue(std::string_view(value ? value : ""));
+		}
+	}
+
+	void AddValue(const qString& value) { AddValue(value.mData); }
+
+	void AddComment(std::string_view comment)
+	{
+		if (mRecord)
+		{
+			mRecording.AddText(XMLRecording::OP_COMMENT, 0, comment.data(), comment.size());
+			FlushIfFull();
+			return;
+		}
+
+		if (mEngineWriter)
+		{
+			mEngineValue.assign(comment.data(), comment.size());
+			mEngineWriter->AddComment(mEngineValue.c_str());
+			return;
+		}
+
+		ClosePendingTag();
+		AppendIndent();
+		Append("<!--", 4);
+		Append(comment.data(), comment.size());
+		Append("-->\n", 4);
+		FlushIfFull();
+	}
+};